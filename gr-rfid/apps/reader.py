@@ -74,11 +74,18 @@ class reader_top_block(gr.top_block):
     self.file_sink_reader         = blocks.file_sink(gr.sizeof_float*1,      "../misc/data/reader", False)
     self.file_sink                  = blocks.file_sink(gr.sizeof_gr_complex*1,   "../misc/data/file_sink", False)     ## instead of uhd.usrp_sink
 
+    # Link timing shared by the blocks, e.g. rfid.link_profile(80000, 12.5, 8) for BLF = 80kHz
+    self.profile  = rfid.link_profile()  # BLF = 40kHz, Tari = 48us, DR = 8
+
+    # State of this reader chain, another chain in the same flowgraph gets its own, e.g. rfid.reader_context("ant2")
+    self.context  = rfid.reader_context()
+
     ######## Blocks #########
     self.matched_filter = filter.fir_filter_ccc(self.decim, self.num_taps);
-    self.gate            = rfid.gate(int(self.adc_rate/self.decim))
-    self.tag_decoder    = rfid.tag_decoder(int(self.adc_rate/self.decim))
-    self.reader          = rfid.reader(int(self.adc_rate/self.decim),int(self.dac_rate))
+    self.gate            = rfid.gate(self.context, int(self.adc_rate/self.decim), 1, self.profile)
+    self.tag_decoder    = rfid.tag_decoder(self.context, int(self.adc_rate/self.decim), 1, self.profile)
+    self.reader          = rfid.reader(self.context, int(self.adc_rate/self.decim),int(self.dac_rate), self.profile)
+    #self.reader.set_run_limits(0, 0, 0)   # continuous inventory until 'Q', the default stops after MAX_NUM_QUERIES
     self.amp              = blocks.multiply_const_ff(self.ampl)
     self.to_complex      = blocks.float_to_complex()
 
@@ -93,7 +100,7 @@ class reader_top_block(gr.top_block):
       self.connect(self.matched_filter, self.gate)
 
       self.connect(self.gate, self.tag_decoder)
-      self.connect((self.tag_decoder,0), self.reader)
+      self.msg_connect(self.tag_decoder, "rn16", self.reader, "rn16")
       self.connect(self.reader, self.amp)
       self.connect(self.amp, self.to_complex)
       self.connect(self.to_complex, self.sink)
@@ -110,14 +117,14 @@ class reader_top_block(gr.top_block):
       self.connect(self.file_source, self.matched_filter)
       self.connect(self.matched_filter, self.gate)
       self.connect(self.gate, self.tag_decoder)
-      self.connect((self.tag_decoder,0), self.reader)
+      self.msg_connect(self.tag_decoder, "rn16", self.reader, "rn16")
       self.connect(self.reader, self.amp)
       self.connect(self.amp, self.to_complex)
       self.connect(self.to_complex, self.file_sink)
 
     #File sinks for logging
     self.connect(self.gate, self.file_sink_gate)
-    self.connect((self.tag_decoder,1), self.file_sink_decoder) # (Do not comment this line)
+    self.connect(self.tag_decoder, self.file_sink_decoder) # (Do not comment this line)
     #self.connect(self.file_sink_reader, self.file_sink_reader)
     self.connect(self.matched_filter, self.file_sink_matched_filter)
 
@@ -127,9 +134,12 @@ if __name__ == '__main__':
   main_block.start()
 
   while(1):
-    inp = raw_input("'Q' to quit \n")
+    inp = raw_input("'Q' to quit, 'L' to write the latency histograms \n")
     if (inp == "q" or inp == "Q"):
       break
+    if (inp == "l" or inp == "L"):
+      main_block.reader.print_latency()
 
   main_block.reader.print_results()
+  main_block.reader.print_latency()
   main_block.stop()
@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_EPC_TABLE_H
+#define INCLUDED_RFID_EPC_TABLE_H
+
+#include <rfid/api.h>
+#include <rfid/gen2_codec.h>
+#include <complex>
+#include <stdint.h>
+#include <vector>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Inventory of the tags read so far, keyed on the full PC + EPC
+    //
+    // Open addressing with linear probing over a flat array of entries. The
+    // table is allocated once with reserve() for the most tags it may hold
+    // and never grows, so the decode path only hashes and probes and the
+    // load factor stays at most one half. Once max_tags tags are in it the
+    // reads of new tags are dropped.
+    //
+    // A false CRC repair gives a random key, so the entries only read
+    // through repairs are capped at max_unconfirmed. The least recently read
+    // of them is evicted for a new one, and for a new tag read clean when
+    // the table is full.
+
+    const int EPC_KEY_BITS  = 112;  // PC (16) + EPC (96)
+    const int EPC_KEY_BYTES = EPC_KEY_BITS / 8;
+
+    struct epc_entry
+    {
+      uint8_t key[EPC_KEY_BYTES];
+      bool used;
+
+      int n_reads;
+      int n_repaired;                // reads which passed the CRC only after the bit flipping repair
+      uint64_t first_seen;           // sample index of the first and the last read
+      uint64_t last_seen;
+      double corr_sum;               // sum of the correlation magnitudes
+      std::complex<double> phase_sum;  // sum of the unit correlation phasors
+
+      uint16_t pc(void) const { return (key[0] << 8) | key[1]; }
+      bool confirmed(void) const { return n_reads > n_repaired; }  // read at least once with a clean CRC
+      double mean_corr(void) const { return n_reads ? corr_sum / n_reads : 0; }
+      double mean_phase(void) const { return std::arg(phase_sum); }
+    };
+
+    class RFID_API epc_table
+    {
+      private:
+        std::vector<epc_entry> entries;
+        uint32_t mask;  // entries.size() - 1, the size is a power of two
+        int n_used;
+        int n_confirmed;
+        int max_tags, max_unconfirmed;
+        uint64_t n_dropped, n_evicted;
+
+        uint32_t hash(const uint8_t * key) const;
+        uint32_t probe(const uint8_t * key) const;  // slot of the key, or the empty slot it goes to
+        void rehash(int n_slots);
+        void erase(uint32_t i);
+        bool evict_unconfirmed(void);
+
+      public:
+        epc_table(void);
+
+        // allocates the table for at most max_tags tags, max_unconfirmed of them only read through repairs
+        void reserve(int max_tags, int max_unconfirmed);
+        // lowers the most tags kept, up to the reserved number (0 for all of it)
+        void set_max_tags(int max_tags);
+        void clear(void);
+        int size(void) const { return n_used; }
+        int capacity(void) const { return entries.size() / 2; }
+        int confirmed(void) const { return n_confirmed; }
+        uint64_t dropped(void) const { return n_dropped; }   // reads of new tags which did not fit
+        uint64_t evicted(void) const { return n_evicted; }   // unconfirmed entries evicted
+
+        // counts a read of the PC + EPC in the first EPC_KEY_BITS bits of reply,
+        // NULL if the reply is too short or the tag is new and does not fit
+        epc_entry * add_read(const gen2_bits & reply, uint64_t sample_index, std::complex<float> corr, bool repaired = false);
+        const epc_entry * find(const gen2_bits & reply) const;
+
+        // used entries, in order of first read
+        std::vector<const epc_entry *> sorted(void) const;
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_EPC_TABLE_H */
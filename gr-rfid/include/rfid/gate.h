@@ -23,6 +23,8 @@
 
 #include <rfid/api.h>
 #include <gnuradio/block.h>
+#include <rfid/link_profile.h>
+#include <rfid/reader_context.h>
 
 namespace gr {
   namespace rfid {
@@ -47,8 +49,13 @@ namespace gr {
        * constructor is in a private implementation
        * class. rfid::gate::make is the public interface for
        * creating new instances.
+       *
+       * \param context state shared with the tag_decoder and reader of the chain
+       * \param sample_rate sample rate of the RX channels
+       * \param n_channels number of RX channels (antennas), one input and output per channel
+       * \param profile timing of the link, the command pulses and the search windows
        */
-      static sptr make(int sample_rate);
+      static sptr make(reader_context::sptr context, int sample_rate, int n_channels = 1, const link_profile & profile = link_profile());
 
     };
 
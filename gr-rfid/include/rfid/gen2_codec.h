@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_GEN2_CODEC_H
+#define INCLUDED_RFID_GEN2_CODEC_H
+
+#include <rfid/api.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Packed bit buffers and the Gen2 reader commands
+    //
+    // Bits are stored MSB first, bit 0 is the first bit on the air. A buffer
+    // has a fixed capacity, so commands and tag replies are built and checked
+    // without touching the heap.
+
+    const int GEN2_MAX_BITS = 256;
+
+    class RFID_API gen2_bits
+    {
+      private:
+        uint8_t data[GEN2_MAX_BITS / 8];
+        int n_bits;
+
+      public:
+        gen2_bits(void) : n_bits(0) { memset(data, 0, sizeof(data)); }
+
+        void clear(void) { memset(data, 0, sizeof(data)); n_bits = 0; }
+        int size(void) const { return n_bits; }
+        const uint8_t * bytes(void) const { return data; }
+
+        int bit(int i) const { return (data[i >> 3] >> (7 - (i & 7))) & 1; }
+        int operator[](int i) const { return bit(i); }
+
+        // bits past GEN2_MAX_BITS are dropped
+        void push(int bit)
+        {
+          if(n_bits >= GEN2_MAX_BITS) return;
+          if(bit) data[n_bits >> 3] |= 0x80 >> (n_bits & 7);
+          n_bits++;
+        }
+
+        // the n lowest bits of value, MSB first
+        void push(uint32_t value, int n)
+        {
+          for(int i = n - 1; i >= 0; i--)
+            push((value >> i) & 1);
+        }
+
+        void flip(int i) { data[i >> 3] ^= 0x80 >> (i & 7); }
+
+        // n bits (up to 32) starting at start, MSB first
+        uint32_t get(int start, int n) const
+        {
+          uint32_t value = 0;
+          for(int i = 0; i < n; i++)
+            value = (value << 1) | bit(start + i);
+          return value;
+        }
+
+        bool operator==(const gen2_bits & other) const
+        {
+          if(n_bits != other.n_bits) return false;
+          for(int i = 0; i < n_bits; i++)
+            if(bit(i) != other.bit(i)) return false;
+          return true;
+        }
+    };
+
+    // command codes and lengths, in bits
+    const uint32_t GEN2_QUERY_CODE        = 0x8;   // 1000
+    const uint32_t GEN2_QUERY_REP_CODE    = 0x0;   // 00
+    const uint32_t GEN2_ACK_CODE          = 0x1;   // 01
+    const uint32_t GEN2_NAK_CODE          = 0xC0;  // 11000000
+    const uint32_t GEN2_QUERY_ADJUST_CODE = 0x9;   // 1001
+
+    const int GEN2_QUERY_BITS        = 22;
+    const int GEN2_QUERY_REP_BITS    = 4;
+    const int GEN2_ACK_BITS          = 18;
+    const int GEN2_NAK_BITS          = 8;
+    const int GEN2_QUERY_ADJUST_BITS = 9;
+
+    // UpDn field of QueryAdjust
+    enum GEN2_Q_UPDN {GEN2_Q_UNCHANGED = 0x0, GEN2_Q_DECREMENT = 0x3, GEN2_Q_INCREMENT = 0x6};
+
+    struct gen2_query
+    {
+      int dr;
+      int m;
+      int trext;
+      int sel;
+      int session;
+      int target;
+      int q;
+    };
+
+    // CRC-5 (x^5 + x^3 + 1, preset 01001) of the first n bits
+    RFID_API uint8_t gen2_crc5(const gen2_bits & bits, int n);
+    // CRC-16 (CCITT, preset 0xFFFF, ones complement) of the first n bits
+    RFID_API uint16_t gen2_crc16(const gen2_bits & bits, int n);
+
+    RFID_API void gen2_append_crc5(gen2_bits * bits);
+    RFID_API void gen2_append_crc16(gen2_bits * bits);
+    // true if the last 16 bits of the first n are the CRC-16 of the ones before
+    RFID_API bool gen2_check_crc16(const gen2_bits & bits, int n);
+
+    // Chase repair of a reply of n bits which fails the CRC-16: every
+    // combination of the bits less confident than max_confidence is flipped
+    // until the CRC passes. The CRC is linear, so each try only xors the
+    // syndrome of one bit. A reply with more than n_candidates weak bits is
+    // not tried, every try is a 2^-16 chance of passing on a wrong reply.
+    // Returns the number of flipped bits, or -1 if no combination passes
+    // (bits is then unchanged).
+    RFID_API int gen2_repair_crc16(gen2_bits * bits, int n, const float * confidence, int n_candidates, float max_confidence);
+
+    RFID_API void gen2_encode_query(const gen2_query & query, gen2_bits * out);
+    RFID_API void gen2_encode_query_rep(int session, gen2_bits * out);
+    RFID_API void gen2_encode_ack(uint16_t rn16, gen2_bits * out);
+    RFID_API void gen2_encode_nak(gen2_bits * out);
+    RFID_API void gen2_encode_query_adjust(int session, GEN2_Q_UPDN updn, gen2_bits * out);
+
+    // the decoders check the command code, the length and the CRC if the command has one
+    RFID_API bool gen2_decode_query(const gen2_bits & bits, gen2_query * query);
+    RFID_API bool gen2_decode_query_rep(const gen2_bits & bits, int * session);
+    RFID_API bool gen2_decode_ack(const gen2_bits & bits, uint16_t * rn16);
+    RFID_API bool gen2_decode_nak(const gen2_bits & bits);
+    RFID_API bool gen2_decode_query_adjust(const gen2_bits & bits, int * session, GEN2_Q_UPDN * updn);
+  }
+}
+
+#endif /* INCLUDED_RFID_GEN2_CODEC_H */
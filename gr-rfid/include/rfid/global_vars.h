@@ -22,6 +22,18 @@
 #define INCLUDED_RFID_GLOBAL_VARS_H
 
 #include <rfid/api.h>
+#include <rfid/gen2_codec.h>
+#include <rfid/epc_table.h>
+#include <rfid/q_algorithm.h>
+#include <rfid/link_profile.h>
+#include <rfid/reader_context.h>
+#include <rfid/latency_histogram.h>
+#include <rfid/stat_counter.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <vector>
 #include <sys/time.h>
@@ -35,39 +47,118 @@ namespace gr {
     enum GATE_STATUS        {GATE_START, GATE_TRACK, GATE_READY, GATE_OPEN, GATE_CLOSED, GATE_SEEK, GATE_SEEK_RN16, GATE_SEEK_EPC};
     enum DECODER_STATUS     {DECODER_DECODE_RN16, DECODER_DECODE_EPC, DECODER_TERMINATED};
     enum READER_SENT_STATUS {PREAMBLE, FRAME_SYNC};
+    enum FM0_DECODER        {FM0_GREEDY, FM0_VITERBI};
 
+    // latencies of the RN16 to ACK turnaround, every one in ns
+    enum LATENCY
+    {
+      LAT_TAG_T1,               // end of the reader command to the tag preamble, on the sample clock
+      LAT_GATE_TO_PREAMBLE,     // gate open to preamble found
+      LAT_PREAMBLE_TO_RN16,     // preamble found to RN16 decoded
+      LAT_RN16_TO_ACK_QUEUED,   // RN16 decoded to ACK queued by the reader
+      LAT_ACK_QUEUED_TO_SENT,   // ACK queued to its first sample emitted
+      LAT_GATE_TO_ACK_SENT,     // whole turnaround, gate open to ACK emitted
+      N_LATENCIES
+    };
+
+    // outcome of every reply window, broken down for the live statistics
+    enum SLOT_RESULT
+    {
+      RESULT_GATE_FAIL,         // the gate did not find the end of the reader command
+      RESULT_PREAMBLE_FAIL,     // the gate opened but no preamble was found, empty slot or collision
+      RESULT_RN16_OK,
+      RESULT_CRC_FAIL,
+      RESULT_EPC_OK,
+      N_SLOT_RESULTS
+    };
+
+    // the last ACK_HISTORY_SIZE ACKs, the oldest is overwritten
+    const int ACK_HISTORY_SIZE = 64;
+
+    struct ACK_HISTORY
+    {
+      struct entry
+      {
+        int round;
+        int slot;
+        uint16_t rn16;
+      };
+
+      entry ring[ACK_HISTORY_SIZE];
+      uint64_t n_pushed;
+
+      ACK_HISTORY() : n_pushed(0) {}
+
+      void push(int round, int slot, uint16_t rn16)
+      {
+        entry & e = ring[n_pushed++ % ACK_HISTORY_SIZE];
+        e.round = round;
+        e.slot  = slot;
+        e.rn16  = rn16;
+      }
+      int size(void) const { return std::min<uint64_t>(n_pushed, ACK_HISTORY_SIZE); }
+      // i = 0 is the oldest entry kept
+      const entry & operator[](int i) const { return ring[(n_pushed - size() + i) % ACK_HISTORY_SIZE]; }
+    };
+
+    // conditions which end the inventory, checked at the end of every slot.
+    // They can be changed while the flowgraph runs, 0 removes a limit.
+    struct RUN_LIMITS
+    {
+      std::atomic<long> max_duration_ms;
+      std::atomic<long> max_unique_tags;
+      std::atomic<long> max_queries;      // Query, QueryRep and QueryAdjust
+      std::atomic<long> max_table_tags;   // most tags kept in tag_reads, up to TAG_TABLE_SIZE (0 for all of it)
+    };
 
+    // the counters and the slot position are written from the block threads
+    // and read by the stats exporter while they run
     struct READER_STATS
     {
-      int n_queries_sent;
-      int n_ack_sent;
+      stat_counter n_queries_sent;
+      stat_counter n_ack_sent;
 
-      int cur_inventory_round;
-      int cur_slot_number;
+      // the slot position and the Q state share the lines between the aligned
+      // n_ack_sent and n_slots, they change once per slot
+      std::atomic<int> cur_inventory_round;
+      std::atomic<int> cur_slot_number;
 
-      int max_slot_number;
+      std::atomic<int> max_slot_number;
       int max_inventory_round;
 
-      int n_epc_correct;
+      q_algorithm q;               // Q of the current round, follows the slot outcomes
+      GEN2_Q_UPDN q_adjust;        // UpDn of the QueryAdjust to send
+      stat_counter n_slots[N_SLOT_OUTCOMES];  // number of empty, single and collided slots
+
+      stat_counter n_results[N_SLOT_RESULTS];  // reply windows by outcome, RESULT_EPC_OK are the correct EPCs
+      stat_counter n_epc_repaired;  // EPCs which passed the CRC only after the soft-decision repair
+      stat_counter n_tags;          // tags of tag_reads read at least once without a repair
+
+      latency_histogram latency[N_LATENCIES];
 
-      std::vector<std::string> ack_sent;
-      std::map<int,int> tag_reads;
+      ACK_HISTORY ack_sent;
+      epc_table tag_reads;  // the tags read so far, keyed on PC + EPC, at most TAG_TABLE_SIZE
 
       struct timeval start, end;
     };
 
     struct READER_STATE
     {
-      STATUS               status;
+      std::atomic<STATUS>  status;    // TERMINATED once a run limit is reached
+      RUN_LIMITS           run_limits;
       GEN2_LOGIC_STATUS   gen2_logic_status;
       GATE_STATUS         gate_status;
       DECODER_STATUS       decoder_status;
       READER_STATS         reader_stats;
       READER_SENT_STATUS   reader_sent_status;
 
-      std::vector<uint8_t> sent_bit;
-      std::vector<float> magn_squared_samples; // used for sync
+      gen2_bits sent_bit;
       int n_samples_to_ungate; // used by the GATE and DECODER block
+
+      // the reader sleeps on wake while it has nothing to send, n_wakes counts the wake_reader() calls
+      std::mutex wake_mutex;
+      std::condition_variable wake;
+      uint64_t n_wakes;
     };
 
     // CONSTANTS (READER CONFIGURATION)
@@ -75,9 +166,16 @@ namespace gr {
     // Fixed number of slots (2^(FIXED_Q))
     const int FIXED_Q              = 0;
 
-    // Termination criteria
-    // const int MAX_INVENTORY_ROUND = 50;
+    // Q algorithm, the number of slots follows the tag population when ADAPTIVE_Q is set
+    const bool ADAPTIVE_Q          = true;
+    const float INITIAL_Q          = 4;
+    const float Q_STEP_C           = 0.3;   // 0.1 < C < 0.5, larger follows the population faster
+    const float COLLISION_ENERGY_RATIO = 2; // A window without preamble is a collision above this power over the noise
+
+    // Termination criteria, the defaults of RUN_LIMITS. 0 runs without the limit,
+    // continuous inventory runs with all three at 0
     const int MAX_NUM_QUERIES     = 16000;     // Stop after MAX_NUM_QUERIES have been sent
+    const int MAX_DURATION_MS     = 0;         // Stop after MAX_DURATION_MS of inventory
 
     // valid values for Q
     const int Q_VALUE [16][4] =
@@ -90,24 +188,38 @@ namespace gr {
 
     const bool P_DOWN = false;
 
+    // Live statistics, a snapshot is written to stats_file_path every period while the flowgraph runs
+    const bool STATS_EXPORT           = true;
+    const int STATS_EXPORT_PERIOD_MS  = 1000;
+    const int STATS_RATE_WINDOW       = 10;   // periods the reads/s and slot efficiency are averaged over
+
+    // Longest the reader sleeps with nothing to send, end_slot and the RN16s wake it earlier
+    const int READER_IDLE_WAIT_MS     = 10;
+
+    // Default link profile, the blocks take a link_profile which derives
+    // Tpri (25us), RTcal (72us), TRcal (200us), T1 (250us) and T2 (500us) from these
     const int T_READER_FREQ = 40000;     // BLF = 40kHz
 
     // Duration in us
-    const int DR_D          = 8;
-    const float BLF_D     = T_READER_FREQ / pow(10,6);  // 0.04
-    const float TPRI_D      = 1 / BLF_D;  // 25us
+    const float DR_D        = 8;
     const float PW_D        = 24; // Half Tari
-    const float RTCAL_D     = 6 * PW_D; // 72us
-    const float TRCAL_D     = DR_D / BLF_D; // 200us
-    const float T1_D        = std::max(RTCAL_D, 10 * TPRI_D);  // 250us
-    const float T2_D        = 20 * TPRI_D;  // 500us
 
     const int CW_D         = 250;    // Carrier wave
     const int P_DOWN_D     = 2000;    // power down
     const int DELIM_D       = 12;      // A preamble shall comprise a fixed-length start delimiter 12.5us +/-5%
 
+    // Gate search windows
+    const int SEARCH_TRACK_D = 10000;
+    const int SEARCH_READY_D = 4000;
+    const int SEARCH_SEEK_D  = 4000;
+
     const int NUM_PULSES_COMMAND = 5;       // Number of pulses to detect a reader command
-    const int NUMBER_UNIQUE_TAGS = 100;      // Stop after NUMBER_UNIQUE_TAGS have been read
+    const int NUMBER_UNIQUE_TAGS = 0;        // Stop after NUMBER_UNIQUE_TAGS have been read
+    const int TAG_TABLE_SIZE     = 4096;     // Most tags the EPC table holds, it is allocated once for them
+    const int TAG_TABLE_UNCONFIRMED = 64;    // Most tags in it only read through CRC repairs, the oldest is evicted
+    const int CRC_REPAIR_BITS    = 6;        // Most weak EPC bits retried on a CRC failure (2^n - 1 tries)
+    const float CRC_REPAIR_CONFIDENCE = 0.5; // A bit is weak below this share of the mean bit confidence of the reply
+    const FM0_DECODER FM0_DECODER_MODE = FM0_VITERBI;  // FM0_GREEDY decides every bit on its own
 
 
     // Number of bits
@@ -118,10 +230,6 @@ namespace gr {
     const int QUERY_LENGTH        = 22;  // Query length in bits
     const int EXTRA_BITS          = 12; // extra bits to ungate
 
-    // Duration in us
-    const int RN16_D       = (RN16_BITS + TAG_PREAMBLE_BITS) * TPRI_D;  // 575us
-    const int EPC_D        = (EPC_BITS  + TAG_PREAMBLE_BITS) * TPRI_D;  // 3,375us
-
     // Query command
     const int QUERY_CODE[4] = {1,0,0,0};
     const int M[2]          = {0,0};
@@ -129,7 +237,6 @@ namespace gr {
     const int SESSION[2]     = {0,0};
     const int TARGET         = 0;
     const int TREXT         = 0;
-    const int DR            = 0;
 
 
     const int NAK_CODE[8]   = {1,1,0,0,0,0,0,0};
@@ -155,17 +262,27 @@ namespace gr {
     const float THRESH_FRACTION = 0.75;
     const int WIN_SIZE_D         = 250;
 
-    // Duration in which dc offset is estimated (T1_D is 250)
+    // Duration in which dc offset is estimated (T1 is 250)
     const int DC_SIZE_D         = 120;
 
-    // Global variable
-    extern READER_STATE * reader_state;
-    extern void initialize_reader_state();
+    // Gate captures, the samples of every gate event are kept in a ring file of fixed size per channel
+    const bool GATE_CAPTURE            = true;
+    const uint64_t GATE_CAPTURE_FILE_SIZE = 64 << 20;  // 64MB, the oldest captures are overwritten
+
+    // every chain of gate, tag_decoder and reader shares one READER_STATE, owned by its reader_context
+    extern void initialize_reader_state(READER_STATE * reader_state);
+    // closes the current slot and sets the next command, true if a new inventory round starts or the inventory ends
+    extern bool end_slot(READER_STATE * reader_state, SLOT_OUTCOME outcome);
+    // wakes the reader if it sleeps, after a change it has to act on
+    extern void wake_reader(READER_STATE * reader_state);
 
     // file path
     const std::string log_file_path = "log";
     const std::string result_file_path = "result";
+    const std::string latency_file_path = "latency";
+    const std::string stats_file_path = "stats.prom";
     const std::string debug_folder_path = "debug_data/";
+    const std::string gate_capture_file_path = "gateOpenTracker/capture";
   } // namespace rfid
 } // namespace gr
 
@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_LATENCY_HISTOGRAM_H
+#define INCLUDED_RFID_LATENCY_HISTOGRAM_H
+
+#include <rfid/api.h>
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Histogram of latencies, in the style of HdrHistogram
+    //
+    // Values are counted in log-linear buckets: every power of two is split
+    // into LATENCY_SUB_BUCKETS linear buckets, so a bucket is within 1/16 of
+    // the values it holds from 1 ns to 2^40 ns. Every counter is atomic and
+    // record() only does relaxed increments, so the blocks record from their
+    // own threads and the histogram can be read at any time.
+
+    const int LATENCY_SUB_BITS    = 4;
+    const int LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BITS;
+    const int LATENCY_MAX_BITS    = 40;  // larger values are counted in the last bucket
+    const int LATENCY_N_BUCKETS   = (LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS;
+
+    // steady clock of the latency stamps, in ns
+    RFID_API int64_t latency_clock_ns(void);
+
+    class RFID_API latency_histogram
+    {
+      private:
+        std::atomic<uint64_t> counts[LATENCY_N_BUCKETS];
+        std::atomic<uint64_t> n_values;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min_value;
+        std::atomic<uint64_t> max_value;
+
+      public:
+        latency_histogram(void);
+
+        static int bucket(uint64_t value);
+        static uint64_t bucket_low(int bucket);   // smallest and largest value of a bucket
+        static uint64_t bucket_high(int bucket);
+
+        // negative values (clocks of different threads) are counted as zero
+        void record(int64_t value);
+        void reset(void);
+
+        uint64_t count(void) const { return n_values.load(std::memory_order_relaxed); }
+        uint64_t min(void) const;
+        uint64_t max(void) const { return max_value.load(std::memory_order_relaxed); }
+        double mean(void) const;
+        // largest value of the bucket holding the p-th percentile, 0 <= p <= 100
+        uint64_t percentile(double p) const;
+
+        // one line summary, values divided by scale
+        void print_summary(std::ostream & out, double scale) const;
+        // every non empty bucket with its cumulative fraction
+        void print_buckets(std::ostream & out, double scale) const;
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_LATENCY_HISTOGRAM_H */
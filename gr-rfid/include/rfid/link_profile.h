@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_LINK_PROFILE_H
+#define INCLUDED_RFID_LINK_PROFILE_H
+
+#include <rfid/api.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Timing of the reader to tag and tag to reader links
+    //
+    // Every duration is in us and derived from the BLF, the half Tari (PW)
+    // and DR as in the Gen2 specification. The blocks take a profile at
+    // make() and build their sample counts, waveforms and decoder tables
+    // from it, so another link only needs another profile. The default one
+    // is the configuration in global_vars.h. A profile the tags cannot
+    // follow (DR other than 8 or 64/3, TRcal outside 1.1 to 3 RTcal) throws
+    // std::invalid_argument.
+
+    struct RFID_API link_profile
+    {
+      int blf;             // backscatter link frequency (Hz)
+      float pw;            // half Tari, data-0 is 2 PW and data-1 is 4 PW
+      float dr;            // divide ratio, 8 or 64/3
+
+      float tpri;          // tag bit
+      float rtcal;
+      float trcal;
+      float t1;            // reader command to tag reply
+      float t2;            // tag reply to next reader command
+      float delim;
+      float cw;            // carrier before every command
+      float p_down;
+      float rn16;          // RN16 and EPC replies with their preamble
+      float epc;
+
+      float search_track;  // time the gate searches a reader command
+      float search_ready;  // time the gate waits for the end of a command
+      float search_seek;   // time the gate searches the first command
+
+      link_profile(void);
+      link_profile(int blf, float pw, float dr);
+
+      // DR field of the Query, 0 for DR = 8 and 1 for DR = 64/3
+      int dr_bit(void) const { return dr > 8 ? 1 : 0; }
+
+      // samples of a duration at sample_rate
+      float samples(float duration, int sample_rate) const { return duration * (sample_rate / 1e6); }
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_LINK_PROFILE_H */
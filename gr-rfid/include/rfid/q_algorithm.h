@@ -0,0 +1,65 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_Q_ALGORITHM_H
+#define INCLUDED_RFID_Q_ALGORITHM_H
+
+#include <rfid/api.h>
+#include <rfid/gen2_codec.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Q algorithm of the Gen2 specification (Annex D)
+    //
+    // A floating point Qfp moves down by C after an empty slot and up by C
+    // after a collision, Q is Qfp rounded. With C at most 0.5, Q changes by
+    // at most one per slot, which is what a QueryAdjust can tell the tags.
+    // A slot whose reader command was not seen (SLOT_UNKNOWN) leaves Qfp
+    // unchanged.
+
+    enum SLOT_OUTCOME {SLOT_EMPTY, SLOT_SINGLE, SLOT_COLLISION, SLOT_UNKNOWN, N_SLOT_OUTCOMES};
+
+    const int GEN2_MIN_Q = 0;
+    const int GEN2_MAX_Q = 15;
+
+    class RFID_API q_algorithm
+    {
+      private:
+        float qfp;
+        float c;
+        int cur_q;
+
+      public:
+        q_algorithm(void);
+
+        void reset(float initial_q, float c);
+        int q(void) const { return cur_q; }
+        int n_slots(void) const { return 1 << cur_q; }
+
+        // updates Qfp with the outcome of a slot, returns the UpDn of the
+        // QueryAdjust which moves the tags to the new Q
+        GEN2_Q_UPDN update(SLOT_OUTCOME outcome);
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_Q_ALGORITHM_H */
@@ -23,6 +23,8 @@
 
 #include <rfid/api.h>
 #include <gnuradio/block.h>
+#include <rfid/link_profile.h>
+#include <rfid/reader_context.h>
 
 namespace gr {
   namespace rfid {
@@ -32,6 +34,9 @@ namespace gr {
      *
      * It moves between the following states.
      *
+     * The RN16s decoded by the tag_decoder arrive on the "rn16" message
+     * port, the ACK is queued from the message handler.
+     *
      * \ingroup rfid
      *
      */
@@ -40,6 +45,14 @@ namespace gr {
      public:
       typedef boost::shared_ptr<reader> sptr;
       virtual void print_results() =0;
+      // writes the RN16 to ACK latency histograms, can be called while running
+      virtual void print_latency() =0;
+      // ends the inventory after duration seconds, unique_tags tags read or
+      // queries Query/QueryRep/QueryAdjust sent, whichever comes first. 0
+      // removes a limit, all three at 0 inventory until the flowgraph stops.
+      // Can be called while running, the flowgraph finishes at the slot end
+      // which reaches a limit.
+      virtual void set_run_limits(double duration, int unique_tags, int queries) =0;
       /*!
        * \brief Return a shared_ptr to a new instance of rfid::reader.
        *
@@ -47,8 +60,13 @@ namespace gr {
        * constructor is in a private implementation
        * class. rfid::reader::make is the public interface for
        * creating new instances.
+       *
+       * \param context state shared with the gate and tag_decoder of the chain
+       * \param sample_rate sample rate of the RX channels
+       * \param dac_rate sample rate of the transmitted commands
+       * \param profile timing of the link the commands are rendered for
        */
-      static sptr make(int sample_rate, int dac_rate);
+      static sptr make(reader_context::sptr context, int sample_rate, int dac_rate, const link_profile & profile = link_profile());
 
     };
 
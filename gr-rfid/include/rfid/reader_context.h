@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_READER_CONTEXT_H
+#define INCLUDED_RFID_READER_CONTEXT_H
+
+#include <rfid/api.h>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace gr
+{
+  namespace rfid
+  {
+    struct READER_STATE;
+
+    /*!
+     * \brief State shared by one gate, tag_decoder and reader.
+     *
+     * The three blocks of a reader chain drive each other through the
+     * Gen2 state, the slot position and the statistics of their context.
+     * Every chain is made with its own context, so several readers (one
+     * per USRP or RX channel set) run independently in one process.
+     *
+     * \ingroup rfid
+     */
+    class RFID_API reader_context
+    {
+      private:
+        std::string context_name;
+        READER_STATE * reader_state;
+
+        reader_context(const std::string & name);
+
+      public:
+        typedef boost::shared_ptr<reader_context> sptr;
+
+        /*!
+         * \param name appended to the result, latency, stats and capture
+         * files of the chain, "" keeps the default file names
+         */
+        static sptr make(const std::string & name = "");
+        ~reader_context();
+
+        const std::string & name(void) const { return context_name; }
+
+        // base path of an output file with the name of the chain appended
+        std::string file_path(const std::string & base) const;
+
+#ifndef SWIG
+        READER_STATE * state(void) const { return reader_state; }
+#endif
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_READER_CONTEXT_H */
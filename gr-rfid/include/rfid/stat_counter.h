@@ -0,0 +1,55 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_STAT_COUNTER_H
+#define INCLUDED_RFID_STAT_COUNTER_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    const int STAT_CACHE_LINE = 64;
+
+    // Counter of READER_STATS
+    //
+    // The gate, tag_decoder and reader bump the counters from their own
+    // threads and the stats exporter reads them while they run. A counter is
+    // a relaxed atomic aligned to and filling a whole cache line, so two
+    // counters bumped by different threads never share a line, nor does a
+    // counter share one with the fields around it. The structs holding them
+    // must come from an aligned allocation, see reader_context.
+
+    struct alignas(STAT_CACHE_LINE) stat_counter
+    {
+      std::atomic<uint64_t> value;
+
+      stat_counter(void) : value(0) {}
+
+      void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+      void store(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+      uint64_t load(void) const { return value.load(std::memory_order_relaxed); }
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_STAT_COUNTER_H */
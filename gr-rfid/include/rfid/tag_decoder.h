@@ -23,12 +23,17 @@
 
 #include <rfid/api.h>
 #include <gnuradio/block.h>
+#include <rfid/link_profile.h>
+#include <rfid/reader_context.h>
 
 namespace gr {
   namespace rfid {
 
     /*!
-     * \brief <+description of block+>
+     * \brief Decodes the tag replies in the windows framed by the gate
+     *
+     * The decoded RN16s are posted on the "rn16" message port for the
+     * reader, the windows of the first channel are forwarded on the output.
      * \ingroup rfid
      *
      */
@@ -44,8 +49,13 @@ namespace gr {
        * constructor is in a private implementation
        * class. rfid::tag_decoder::make is the public interface for
        * creating new instances.
+       *
+       * \param context state shared with the gate and reader of the chain
+       * \param sample_rate sample rate of the RX channels
+       * \param n_channels number of RX channels (antennas), one input per channel
+       * \param profile timing of the link, the tag bit length is taken from its BLF
        */
-      static sptr make(int sample_rate);
+      static sptr make(reader_context::sptr context, int sample_rate, int n_channels = 1, const link_profile & profile = link_profile());
     };
 
   } // namespace rfid
@@ -0,0 +1,163 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "capture_store.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    capture_store::capture_store(const std::string & path, int capacity, uint64_t file_size)
+      : head(0), count(0), end_offset(0), fd(-1), map(NULL), map_size(0)
+    {
+      if(capacity <= 0) return;
+      ring.resize(capacity);
+
+      // room for the header and two full entries, so an entry never overwrites itself
+      uint64_t max_entry = sizeof(capture_entry) + (uint64_t)capacity * sizeof(gr_complex);
+      map_size = std::max(file_size, sizeof(capture_file_header) + 2 * max_entry);
+
+      // the captures of a previous run are dropped
+      fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if(fd < 0) return;
+
+      void * p = MAP_FAILED;
+      if(ftruncate(fd, map_size) == 0)
+        p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if(p == MAP_FAILED)
+      {
+        close(fd);
+        fd = -1;
+        return;
+      }
+      map = (char *)p;
+
+      capture_file_header init = {CAPTURE_FILE_MAGIC, 2, sizeof(gr_complex), 0, map_size, sizeof(capture_file_header), sizeof(capture_file_header)};
+      memcpy(map, &init, sizeof(init));
+    }
+
+    capture_store::~capture_store()
+    {
+      if(map) munmap(map, map_size);
+      if(fd >= 0) close(fd);
+    }
+
+    uint64_t capture_store::entry_end(uint64_t pos)
+    {
+      const capture_entry * entry = (const capture_entry *)(map + pos);
+      return pos + sizeof(capture_entry) + (uint64_t)entry->length * sizeof(gr_complex);
+    }
+
+    uint64_t capture_store::skip_wrap(uint64_t pos)
+    {
+      // the entries go on after the header past the end of the file or a wrap mark
+      if(pos + sizeof(capture_entry) > map_size) return sizeof(capture_file_header);
+      if(((const capture_entry *)(map + pos))->magic == CAPTURE_WRAP_MAGIC) return sizeof(capture_file_header);
+      return pos;
+    }
+
+    void capture_store::drop(uint64_t start, uint64_t end)
+    {
+      capture_file_header * h = header();
+      while(h->n_entries > 0 && h->first >= start && h->first < end)
+      {
+        h->first = skip_wrap(entry_end(h->first));
+        h->n_entries--;
+      }
+    }
+
+    void capture_store::append(const gr_complex * samples, int n, uint64_t offset)
+    {
+      int capacity = ring.size();
+      if(capacity == 0) return;
+
+      // only the last capacity samples are kept
+      if(n > capacity)
+      {
+        samples += n - capacity;
+        offset += n - capacity;
+        n = capacity;
+      }
+
+      int first = std::min(n, capacity - head);
+      memcpy(&ring[head], samples, first * sizeof(gr_complex));
+      memcpy(&ring[0], samples + first, (n - first) * sizeof(gr_complex));
+
+      head = (head + n) % capacity;
+      count = std::min(count + n, capacity);
+      end_offset = offset + n;
+    }
+
+    void capture_store::clear(void)
+    {
+      head = 0;
+      count = 0;
+    }
+
+    void capture_store::commit(int round, int slot, CAPTURE_OUTCOME outcome)
+    {
+      if(is_open())
+      {
+        capture_file_header * h = header();
+        uint64_t n_bytes = sizeof(capture_entry) + (uint64_t)count * sizeof(gr_complex);
+        uint64_t pos = h->next;
+
+        if(pos + n_bytes > map_size)
+        {
+          // the end of the file is given up with the entries in it
+          drop(pos, map_size);
+          if(pos + sizeof(capture_entry) <= map_size)
+          {
+            capture_entry wrap = {CAPTURE_WRAP_MAGIC, 0, 0, 0, 0, 0, 0};
+            memcpy(map + pos, &wrap, sizeof(wrap));
+          }
+          pos = sizeof(capture_file_header);
+        }
+        drop(pos, pos + n_bytes);
+
+        capture_entry entry = {CAPTURE_ENTRY_MAGIC, (uint32_t)round, (uint32_t)slot, (uint32_t)outcome, end_offset - count, (uint32_t)count, 0};
+        memcpy(map + pos, &entry, sizeof(entry));
+
+        // the ring is written oldest sample first
+        int capacity = ring.size();
+        int start = (head - count + capacity) % capacity;
+        int first = std::min(count, capacity - start);
+        char * samples = map + pos + sizeof(entry);
+        memcpy(samples, &ring[start], first * sizeof(gr_complex));
+        memcpy(samples + first * sizeof(gr_complex), &ring[0], (count - first) * sizeof(gr_complex));
+
+        if(h->n_entries == 0) h->first = pos;
+        h->next = pos + n_bytes;
+        h->n_entries++;
+      }
+
+      clear();
+    }
+  }
+}
@@ -0,0 +1,115 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_CAPTURE_STORE_H
+#define INCLUDED_RFID_CAPTURE_STORE_H
+
+#include <gnuradio/gr_complex.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Capture store for the gate samples
+    //
+    // Samples are collected in a preallocated ring of fixed capacity (the
+    // oldest samples are overwritten), and every gate event is written to a
+    // memory mapped capture file as an index entry followed by the samples.
+    //
+    // The file has a fixed size and is itself a ring: it is truncated and
+    // mapped once when the store is created, and once the end is reached
+    // the next entries overwrite the oldest ones after the header. A
+    // continuous inventory keeps the last file_size bytes of captures and
+    // the gate never resizes or remaps the file.
+    //
+    // File layout:
+    //   capture_file_header
+    //   capture_entry, gr_complex[length]
+    //   capture_entry, gr_complex[length]
+    //   ...
+    //
+    // The entries run from header.first to header.next. An entry which does
+    // not fit before the end of the file goes after the header, the space it
+    // leaves is marked with a CAPTURE_WRAP_MAGIC entry if it can hold one.
+
+    enum CAPTURE_OUTCOME {CAPTURE_GATE_OPEN, CAPTURE_GATE_FAIL};
+
+    const uint32_t CAPTURE_FILE_MAGIC  = 0x50414352; // "RCAP"
+    const uint32_t CAPTURE_ENTRY_MAGIC = 0x544e4552; // "RENT"
+    const uint32_t CAPTURE_WRAP_MAGIC  = 0x50415257; // "WRAP"
+
+    struct capture_file_header
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t sample_size;   // sizeof(gr_complex)
+      uint32_t n_entries;
+      uint64_t size;          // size of the file
+      uint64_t first;         // position of the oldest entry
+      uint64_t next;          // position after the newest entry
+    };
+
+    struct capture_entry
+    {
+      uint32_t magic;
+      uint32_t round;
+      uint32_t slot;
+      uint32_t outcome;       // CAPTURE_OUTCOME
+      uint64_t sample_offset; // absolute index of the first sample in the gate input stream
+      uint32_t length;        // number of samples following this entry
+      uint32_t reserved;
+    };
+
+    class capture_store
+    {
+      private:
+        std::vector<gr_complex> ring;
+        int head;           // next position to write
+        int count;          // number of valid samples in the ring
+        uint64_t end_offset;  // absolute index of the sample after the last appended one
+
+        int fd;
+        char * map;
+        uint64_t map_size;
+
+        capture_file_header * header(void) { return (capture_file_header *)map; }
+        uint64_t entry_end(uint64_t pos);
+        uint64_t skip_wrap(uint64_t pos);
+        void drop(uint64_t start, uint64_t end);  // drops the oldest entries which start in [start, end)
+
+      public:
+        // a capacity of 0 disables the store, file_size is raised to hold two entries of capacity samples
+        capture_store(const std::string & path, int capacity, uint64_t file_size);
+        ~capture_store();
+
+        bool is_open(void) const { return map != NULL; }
+        int size(void) const { return count; }
+
+        void append(const gr_complex * samples, int n, uint64_t offset);
+        void clear(void);
+        void commit(int round, int slot, CAPTURE_OUTCOME outcome);
+    };
+  }
+}
+
+#endif
@@ -0,0 +1,203 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/epc_table.h>
+#include <algorithm>
+#include <string.h>
+
+#define EPC_TABLE_MIN_SLOTS 16
+
+namespace gr
+{
+  namespace rfid
+  {
+    static bool first_read_before(const epc_entry * a, const epc_entry * b)
+    {
+      return a->first_seen < b->first_seen;
+    }
+
+    epc_table::epc_table(void)
+      : n_used(0), n_confirmed(0)
+    {
+      entries.resize(EPC_TABLE_MIN_SLOTS);
+      mask = EPC_TABLE_MIN_SLOTS - 1;
+      max_tags = max_unconfirmed = capacity();
+      clear();
+    }
+
+    void epc_table::reserve(int max_tags, int max_unconfirmed)
+    {
+      int n_slots = EPC_TABLE_MIN_SLOTS;
+      while(n_slots < 2 * max_tags) n_slots <<= 1;
+      if(n_slots > (int)entries.size()) rehash(n_slots);
+
+      set_max_tags(max_tags);
+      this->max_unconfirmed = std::max(max_unconfirmed, 0);
+    }
+
+    void epc_table::set_max_tags(int max_tags)
+    {
+      this->max_tags = (max_tags > 0) ? std::min(max_tags, capacity()) : capacity();
+    }
+
+    void epc_table::clear(void)
+    {
+      for(size_t i = 0; i < entries.size(); i++)
+        entries[i].used = false;
+      n_used = 0;
+      n_confirmed = 0;
+      n_dropped = 0;
+      n_evicted = 0;
+    }
+
+    uint32_t epc_table::hash(const uint8_t * key) const
+    {
+      // FNV-1a
+      uint32_t h = 2166136261u;
+      for(int i = 0; i < EPC_KEY_BYTES; i++)
+        h = (h ^ key[i]) * 16777619u;
+      return h;
+    }
+
+    uint32_t epc_table::probe(const uint8_t * key) const
+    {
+      uint32_t i = hash(key) & mask;
+      while(entries[i].used && memcmp(entries[i].key, key, EPC_KEY_BYTES) != 0)
+        i = (i + 1) & mask;
+      return i;
+    }
+
+    void epc_table::rehash(int n_slots)
+    {
+      std::vector<epc_entry> old;
+      old.swap(entries);
+
+      entries.resize(n_slots);
+      mask = n_slots - 1;
+      for(size_t i = 0; i < entries.size(); i++)
+        entries[i].used = false;
+
+      for(size_t i = 0; i < old.size(); i++)
+        if(old[i].used) entries[probe(old[i].key)] = old[i];
+    }
+
+    //backward shift deletion, the entries after i move back to the slot they probe first
+    void epc_table::erase(uint32_t i)
+    {
+      entries[i].used = false;
+      for(uint32_t j = (i + 1) & mask; entries[j].used; j = (j + 1) & mask)
+      {
+        uint32_t home = hash(entries[j].key) & mask;
+        // j may move to i if its home slot is not between them
+        if(((i - home) & mask) < ((j - home) & mask))
+        {
+          entries[i] = entries[j];
+          entries[j].used = false;
+          i = j;
+        }
+      }
+    }
+
+    //evicts the least recently read entry which was never read clean
+    bool epc_table::evict_unconfirmed(void)
+    {
+      if(n_used == n_confirmed) return false;
+
+      int oldest = -1;
+      for(size_t i = 0; i < entries.size(); i++)
+        if(entries[i].used && !entries[i].confirmed() && ((oldest < 0) || (entries[i].last_seen < entries[oldest].last_seen)))
+          oldest = i;
+
+      erase(oldest);
+      n_used--;
+      n_evicted++;
+      return true;
+    }
+
+    epc_entry * epc_table::add_read(const gen2_bits & reply, uint64_t sample_index, std::complex<float> corr, bool repaired)
+    {
+      if(reply.size() < EPC_KEY_BITS) return NULL;
+
+      // the key is byte aligned at the start of the reply
+      const uint8_t * key = reply.bytes();
+      epc_entry * entry = &entries[probe(key)];
+
+      if(!entry->used)
+      {
+        // a repaired read only takes the place of another unconfirmed one once they reach their cap,
+        // a clean read takes the place of an unconfirmed one once the table is full
+        bool room;
+        if(repaired && (n_used - n_confirmed >= max_unconfirmed)) room = evict_unconfirmed();
+        else room = (n_used < max_tags) || (!repaired && evict_unconfirmed());
+        if(!room)
+        {
+          n_dropped++;
+          return NULL;
+        }
+
+        // the eviction may have moved the entries
+        entry = &entries[probe(key)];
+        memcpy(entry->key, key, EPC_KEY_BYTES);
+        entry->used = true;
+        entry->n_reads = 0;
+        entry->n_repaired = 0;
+        entry->first_seen = sample_index;
+        entry->corr_sum = 0;
+        entry->phase_sum = 0;
+        n_used++;
+      }
+
+      // a tag only read through repairs may not exist, the first clean read confirms it
+      if(!repaired && !entry->confirmed()) n_confirmed++;
+
+      float magn = std::abs(corr);
+      entry->n_reads++;
+      if(repaired) entry->n_repaired++;
+      entry->last_seen = sample_index;
+      entry->corr_sum += magn;
+      if(magn > 0) entry->phase_sum += std::complex<double>(corr / magn);
+
+      return entry;
+    }
+
+    const epc_entry * epc_table::find(const gen2_bits & reply) const
+    {
+      if(reply.size() < EPC_KEY_BITS) return NULL;
+
+      const epc_entry * entry = &entries[probe(reply.bytes())];
+      return entry->used ? entry : NULL;
+    }
+
+    std::vector<const epc_entry *> epc_table::sorted(void) const
+    {
+      std::vector<const epc_entry *> result;
+      result.reserve(n_used);
+      for(size_t i = 0; i < entries.size(); i++)
+        if(entries[i].used) result.push_back(&entries[i]);
+
+      std::sort(result.begin(), result.end(), first_read_before);
+      return result;
+    }
+  }
+}
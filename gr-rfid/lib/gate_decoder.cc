@@ -1,176 +1,133 @@
 #include "gate_impl.h"
 
+#define PULSE_TOLERANCE (0.1)
+
 namespace gr{
   namespace rfid{
     gate_impl::reader_decoder::reader_decoder
       (int n_samples_DELIM, int n_samples_PW, int n_samples_TRCAL, int n_samples_RTCAL)
-      :n_samples_DELIM(n_samples_DELIM), n_samples_PW(n_samples_PW), n_samples_TRCAL(n_samples_TRCAL), n_samples_RTCAL(n_samples_RTCAL), guess_bit(-1)
+      :n_samples_DELIM(n_samples_DELIM), n_samples_PW(n_samples_PW), n_samples_TRCAL(n_samples_TRCAL), n_samples_RTCAL(n_samples_RTCAL), guess_bit(-1), expected_bits(NULL)
       {
-        decoded_bits.resize(23);
-        reset();
-      }
+        //pulse length bounds of every decode state, built once for the sample rate
+        //(a delimiter is never followed by a valid up pulse)
+        pulse_bounds never = {1, 0};
+
+        down_table[DELIMITER] = make_bounds(n_samples_DELIM);
+        down_table[DATA0]     = make_bounds(n_samples_PW);
+        down_table[RTCAL]     = make_bounds(n_samples_PW);
+        down_table[TRCAL]     = make_bounds(n_samples_PW);
+        down_table[DATAS]     = make_bounds(n_samples_PW);
+
+        up_table[DELIMITER] = never;
+        up_table[DATA0]     = make_bounds(n_samples_PW);
+        up_table[RTCAL]     = make_bounds(n_samples_RTCAL - n_samples_PW);
+        up_table[TRCAL]     = make_bounds(n_samples_TRCAL - n_samples_PW);
+        up_table[DATAS]     = make_bounds(n_samples_PW);
+        data1_bounds        = make_bounds(n_samples_PW * 3);
+
+        //next state after a valid down pulse, for the framesync and the preamble version
+        for(int i = 0; i < 2; i++)
+        {
+          next_state[i][DELIMITER] = DATA0;
+          next_state[i][DATA0]     = RTCAL;
+          next_state[i][RTCAL]     = i ? TRCAL : DATAS;
+          next_state[i][TRCAL]     = DATAS;
+          next_state[i][DATAS]     = DATAS;
+        }
 
-    bool
-      gate_impl::reader_decoder::check_length(int pulse_len, int expected_len, double tolerant_rate)
-      {
-        if(((1.0 - tolerant_rate)*expected_len <= pulse_len) && (pulse_len <= (1.0 + tolerant_rate)*expected_len))
-          return true;
-        else
-          return false;
+        reset();
       }
 
-    void
-      gate_impl::reader_decoder::go_next_decode_state(void)
+    gate_impl::reader_decoder::pulse_bounds
+      gate_impl::reader_decoder::make_bounds(int expected_len)
       {
-        switch(decode_state){
-          case DELIMITER:
-            decode_state = DATA0;
-            break;
-          case DATA0:
-            decode_state = RTCAL;
-            break;
-          case RTCAL:
-            if(is_preamble) decode_state = TRCAL; //preamble
-            else            decode_state = DATAS; //frame sync
-            break;
-          case TRCAL:
-            decode_state = DATAS;
-            break;
-          default:
-            ;
-        }
-
+        pulse_bounds bounds;
+        bounds.min_len = std::ceil((1.0 - PULSE_TOLERANCE) * expected_len);
+        bounds.max_len = std::floor((1.0 + PULSE_TOLERANCE) * expected_len);
+        return bounds;
       }
 
-    int 
+    int
       gate_impl::reader_decoder::up_pulse(int pulse_len)
       {
-        if(up_down_state == true)
+        if(up_down_state == false)
         {
-          up_down_state = false;
-          int expected_len = 0;
-
-          //Handling up pulse based on pulse_len
-          //state DATAS means we are now decoding real bits
-          //state DELIMITER means nothing here, we need to skip it.
-          //other states handles with expected len
-          switch(decode_state)
-          {
-            case DATAS:
-              if(check_length(pulse_len, n_samples_PW, 0.1))
-                guess_bit = 0;
-              else if(check_length(pulse_len, n_samples_PW * 3, 0.1))
-                guess_bit = 1;
-              else
-                reset();
-              return decoded_bits.size();
-            case DELIMITER:
-              reset();
-              return decoded_bits.size();
-
-            case DATA0:
-              expected_len = n_samples_PW;
-              break;
-            case RTCAL:
-              expected_len = n_samples_RTCAL - n_samples_PW;
-              break;
-            case TRCAL:
-              expected_len = n_samples_TRCAL - n_samples_PW;
-              break;
-            default:
-              ; //do nothing
-
-          }
+          reset();
+          return n_bits;
+        }
+        up_down_state = false;
 
-          if(!check_length(pulse_len, expected_len, 0.1))
+        //state DATAS means we are now decoding real bits, the up pulse tells which bit it is
+        if(decode_state == DATAS)
+        {
+          if(up_table[DATAS].contains(pulse_len))
+            guess_bit = 0;
+          else if(data1_bounds.contains(pulse_len))
+            guess_bit = 1;
+          else
             reset();
         }
-        else
-        {
+        else if(!up_table[decode_state].contains(pulse_len))
           reset();
-          return decoded_bits.size();
-        }
+
+        return n_bits;
       }
 
-    int 
+    int
       gate_impl::reader_decoder::down_pulse(int pulse_len)
       {
-        if(up_down_state == false)
+        if(up_down_state == true)
         {
-          up_down_state = true;
-          int expected_len = 0;
-
-          //Handling up pulse based on pulse_len
-          //state DATAS means we are now decoding real bits
-          //state DELIMITER means nothing here, we need to skip it.
-          //other states handles with expected len
-          switch(decode_state)
-          {
-            case DATAS:
-              if(check_length(pulse_len, n_samples_PW, 0.1))
-                decoded_bits.push_back(guess_bit);
-              else
-                reset();
-              return decoded_bits.size();
-            case DELIMITER:
-              expected_len = n_samples_DELIM;
-              break;
-            case DATA0:
-              expected_len = n_samples_PW;
-              break;
-            case RTCAL:
-              expected_len = n_samples_PW;
-              break;
-            case TRCAL:
-              expected_len = n_samples_PW;
-              break;
-            default:
-              ; //do nothing
-
-          }
+          reset();
+          return n_bits;
+        }
+        up_down_state = true;
 
-          if(check_length(pulse_len, expected_len, 0.1))
+        //the bit is complete, it is compared with the sent one right away
+        if(decode_state == DATAS)
+        {
+          if(!down_table[DATAS].contains(pulse_len))
+            reset();
+          else if(expected_bits && ((n_bits >= expected_bits->size()) || (guess_bit != (*expected_bits)[n_bits])))
           {
-            //check success, go to next decode state
-            go_next_decode_state();
+            reset();
+            return BITS_MISMATCH;
           }
           else
-          {
-            if(decode_state == DELIMITER)
-            {
-              //if we are looking for Delimiter, then we quit here
-              reset();
-            }else
-            {
-              reset();
-
-              //we check this down pulse again by recursive method
-              up_down_state = false;
-              down_pulse(pulse_len);
-            }
-          }
+            n_bits++;
 
+          return n_bits;
         }
+
+        if(down_table[decode_state].contains(pulse_len))
+          decode_state = next_state[is_preamble][decode_state];
         else
         {
+          //the pulse may be the delimiter of a new command
+          bool was_delimiter = (decode_state == DELIMITER);
           reset();
+
+          if(!was_delimiter && down_table[DELIMITER].contains(pulse_len))
+          {
+            up_down_state = true;
+            decode_state = DATA0;
+          }
         }
 
-        return decoded_bits.size();
+        return n_bits;
       }
 
-    std::vector<uint8_t> gate_impl::reader_decoder::get_bits(void) {return decoded_bits;}
-
     void gate_impl::reader_decoder::set_preamble(void)  {is_preamble = true;}
     void gate_impl::reader_decoder::set_framesync(void)  {is_preamble = false;}
+    void gate_impl::reader_decoder::set_expected_bits(const gen2_bits * bits)  {expected_bits = bits;}
 
-    int 
+    void
       gate_impl::reader_decoder::reset(void)
       {
         guess_bit = -1;
         up_down_state = false;
         decode_state = DELIMITER;
-        decoded_bits.clear();
+        n_bits = 0;
       }
   }//end of gr
 }//end of rfid
@@ -24,8 +24,11 @@
 
 #include <gnuradio/io_signature.h>
 #include "gate_impl.h"
+#include <volk/volk.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <algorithm>
+#include <thread>
 
 #define AMP_LOWBOUND (0.01) //this will let us find the lowest bound
 #define MIN_PULSE (5)
@@ -33,48 +36,59 @@
 #define AMP_POS_THRESHOLD_RATE (0.7)
 #define AMP_NEG_THRESHOLD_RATE (0.3)
 
-#define MAX_SEARCH_TRACK (MAX_SEARCH_TRACK_TIME * sample_rate)
-#define MAX_SEARCH_TRACK_TIME (10e-3)
-#define MAX_SEARCH_READY (MAX_SEARCH_READY_TIME * sample_rate)
-#define MAX_SEARCH_READY_TIME (4e-3)
-#define MAX_SEARCH_SEEK  (MAX_SEARCH_SEEK_TIME * sample_rate)
-#define MAX_SEARCH_SEEK_TIME  (4e-3)
 #define AMBIENT_START    (AMBIENT_START_TIME * sample_rate)
 #define AMBIENT_START_TIME  (10e-3)
 
+//the initial DC offset is averaged over the first DC_CALIB samples, the reader
+//sends its first carrier only after them, so they are all carrier-off
+#define DC_CALIB      (DC_CALIB_TIME * sample_rate)
+#define DC_CALIB_TIME (2e-3)
+
+//afterwards the DC offset is tracked during the carrier-off pulses of the reader commands,
+//once per search so the gain does not depend on the number of pulses
+#define DC_TRACK_RATE  (0.25)
+#define DC_TRACK_GUARD (2)  //samples skipped at both ends of a pulse
+
+#define GATE_CHUNK_SIZE (4096)
+
 namespace gr
 {
   namespace rfid
   {
     gate::sptr
 
-      gate::make(int sample_rate)
+      gate::make(reader_context::sptr context, int sample_rate, int n_channels, const link_profile & profile)
       {
-        return gnuradio::get_initial_sptr(new gate_impl(sample_rate));
+        return gnuradio::get_initial_sptr(new gate_impl(context, sample_rate, n_channels, profile));
       }
 
     /*
      * The private constructor
      */
-    gate_impl::gate_impl(int sample_rate)
+    gate_impl::gate_impl(reader_context::sptr context, int sample_rate, int n_channels, const link_profile & profile)
       : gr::block("gate",
-          gr::io_signature::make(1, 1, sizeof(gr_complex)),
-          gr::io_signature::make(1, 1, sizeof(gr_complex))),
-      n_samples(0), avg_dc(0,0), num_pulses(0)
+          gr::io_signature::make(n_channels, n_channels, sizeof(gr_complex)),
+          gr::io_signature::make(n_channels, n_channels, sizeof(gr_complex))),
+      context(context), reader_state(context->state()),
+      n_channels(n_channels), log(context->file_path(log_file_path)),
+      pool(std::max(0, std::min(n_channels, (int)std::thread::hardware_concurrency()) - 1))
     {
       this->sample_rate  = sample_rate;
-      n_samples_T1       = T1_D       * (sample_rate / pow(10,6));
-      n_samples_TAG_BIT  = TPRI_D  * (sample_rate / pow(10,6));
-      n_samples_PW       = PW_D  * (sample_rate / pow(10,6));
-      n_samples_RTCAL    = RTCAL_D  * (sample_rate / pow(10,6));
-      n_samples_TRCAL    = TRCAL_D  * (sample_rate / pow(10,6));
-      n_samples_DELIM    = DELIM_D  * (sample_rate / pow(10,6));
-
-      decoder = new reader_decoder(n_samples_DELIM, n_samples_PW, n_samples_TRCAL, n_samples_RTCAL);
-
-      // First block to be scheduled
-      initialize_reader_state();
-
+      n_samples_T1       = profile.samples(profile.t1, sample_rate);
+      n_samples_TAG_BIT  = profile.samples(profile.tpri, sample_rate);
+      n_samples_PW       = profile.samples(profile.pw, sample_rate);
+      n_samples_RTCAL    = profile.samples(profile.rtcal, sample_rate);
+      n_samples_TRCAL    = profile.samples(profile.trcal, sample_rate);
+      n_samples_DELIM    = profile.samples(profile.delim, sample_rate);
+      n_samples_search_track = profile.samples(profile.search_track, sample_rate);
+
+      channel_used.resize(n_channels);
+      for(int c = 0; c < n_channels; c++)
+        channels.push_back(new gate_channel(c, sample_rate, profile, *context));
+
+      //the tag_decoder frames the windows by stream tags and needs a whole window in its input buffer
+      set_tag_propagation_policy(TPP_DONT);
+      set_min_output_buffer(2 * (EPC_BITS + TAG_PREAMBLE_BITS + EXTRA_BITS) * n_samples_TAG_BIT);
     }
 
     /*
@@ -82,13 +96,15 @@ namespace gr
      */
     gate_impl::~gate_impl()
     {
-      delete decoder;
+      for(int c = 0; c < n_channels; c++)
+        delete channels[c];
     }
 
     void
       gate_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
       {
-        ninput_items_required[0] = noutput_items;
+        for(int c = 0; c < n_channels; c++)
+          ninput_items_required[c] = noutput_items;
       }
 
     int
@@ -97,286 +113,594 @@ namespace gr
           gr_vector_const_void_star &input_items,
           gr_vector_void_star &output_items)
       {
-        const gr_complex *in = (const gr_complex *) input_items[0];
-        gr_complex *out = (gr_complex *) output_items[0];
+        //the inventory reached a run limit, the tag_decoder finishes once it drained its input
+        if(reader_state->status == TERMINATED) return WORK_DONE;
 
-        int number_samples_consumed = ninput_items[0];
+        //all the channels are sampled together, the same number of samples is consumed from each
+        int ninput = *std::min_element(ninput_items.begin(), ninput_items.end());
+
+        int number_samples_consumed = 0;
         int written = 0;
 
 
-        log.open(log_file_path, std::ios::app);
-        if(reader_state->gate_status != GATE_CLOSED)
+        if(reader_state->gate_status == GATE_CLOSED)
         {
-          for(int i=0 ; i<ninput_items[0] ; i++)
-          {
-            iq_count++;
-            gr_complex sample = in[i];
-            char data[8];
-            memcpy(data, &sample, 8);
+          number_samples_consumed = ninput;
+          iq_count += number_samples_consumed;
+        }
+
+        //the input is processed chunk by chunk,
+        //each state kernel runs over the chunk until the gate status changes
+        while((number_samples_consumed < ninput) && (reader_state->gate_status != GATE_CLOSED))
+        {
+          int n = std::min(ninput - number_samples_consumed, GATE_CHUNK_SIZE);
+          int used = 0;
 
 #ifdef __GATE_DEBUG__
-            if(prev_gate_status != reader_state->gate_status){
-              prev_gate_status = reader_state->gate_status;
-              switch(reader_state->gate_status){
-                case GATE_START:
-                  log<<"gate start"<<std::endl;
-                  break;
-                case GATE_SEEK_RN16:
-                  log<<"gate seek RN16"<<std::endl;
-                  break;
-                case GATE_TRACK:
-                  log<<"gate track"<<std::endl;
-                  break;
-                case GATE_READY:
-                  log<<"gate ready"<<std::endl;
-                  break;  
-                case GATE_SEEK:
-                  log<<"gate seek"<<std::endl;
-                  break;  
-                case GATE_OPEN:
-                  log<<"gate open"<<std::endl;
-                  break;  
-                case GATE_CLOSED:
-                  log<<"gate closed"<<std::endl;
-                  break;  
-                default:
-                  log<<"WHAT THE HELL???"<<std::endl;
-              }
+          if(prev_gate_status != reader_state->gate_status){
+            prev_gate_status = reader_state->gate_status;
+            switch(reader_state->gate_status){
+              case GATE_START:
+                log.file("gate start\n");
+                break;
+              case GATE_SEEK_RN16:
+                log.file("gate seek RN16\n");
+                break;
+              case GATE_TRACK:
+                log.file("gate track\n");
+                break;
+              case GATE_READY:
+                log.file("gate ready\n");
+                break;  
+              case GATE_SEEK:
+                log.file("gate seek\n");
+                break;  
+              case GATE_OPEN:
+                log.file("gate open\n");
+                break;  
+              case GATE_CLOSED:
+                log.file("gate closed\n");
+                break;  
+              default:
+                log.file("WHAT THE HELL???\n");
             }
+          }
 #endif
 
-
+          switch(reader_state->gate_status)
+          {
             //gate at the beginning
             //
             //In here we do:
             //  - Skipping off-part at the beginning
             //  - calculate DC offset
-            if(reader_state->gate_status == GATE_START)
-            {
-              if(++n_samples <= 20000) 
+            case GATE_START:
+              pool.run(n_channels, [&](int c) {
+                  const gr_complex * chunk_in = (const gr_complex *)input_items[c] + number_samples_consumed;
+                  channel_used[c] = channels[c]->gate_start(chunk_in, n);
+                  });
+
+              //every channel calibrates over the same number of samples,
+              //then the reader powers up the tags
+              used = channel_used[0];
+              if(channels[0]->status != GATE_START)
               {
-                avg_dc += sample;
-              }
-              else if(n_samples > 26000)
-              {
-                avg_dc /= 20000;
-                log << "n_samples_TAG_BIT= " << n_samples_TAG_BIT << std::endl;
-                log << "Average of first 20000 amplitudes= " << avg_dc << std::endl;
-
-                number_samples_consumed = i-1;
-
-                avg_iq = gr_complex(0,0);
-                n_samples = 0;
-                amp_pos_threshold = 0;
-                amp_neg_threshold = 0;
-                max_count = MAX_SEARCH_SEEK;
-
                 reader_state->gate_status = GATE_CLOSED;
-                reader_state->gen2_logic_status = SEND_QUERY;
-
-                break;
+                reader_state->gen2_logic_status = START;
+                wake_reader(reader_state);
               }
-            }
+              break;
+
             //gate mode configure
-            else if(reader_state->gate_status == GATE_SEEK_RN16)
-            {
-              log << "│ Gate seek RN16.." << std::endl;
+            case GATE_SEEK_RN16:
+              log.file("│ Gate seek RN16..\n");
               reader_state->n_samples_to_ungate = (RN16_BITS + TAG_PREAMBLE_BITS + EXTRA_BITS) * n_samples_TAG_BIT;
+              window_mode = DECODER_DECODE_RN16;
+              for(int c = 0; c < n_channels; c++)
+              {
+                channels[c]->seek_reset(n_samples_search_track);
+                channels[c]->capture.clear();
+              }
               reader_state->gate_status = GATE_SEEK;
-              avg_iq = gr_complex(0,0);
-              n_samples = 0;
-              amp_pos_threshold = 0;
-              amp_neg_threshold = 0;
-              max_count = MAX_SEARCH_TRACK;
-              gate_log_samples.clear();
-            }
-            else if(reader_state->gate_status == GATE_SEEK_EPC)
-            {
-              log << "│ Gate seek EPC.." << std::endl;
+              break;
+
+            case GATE_SEEK_EPC:
+              log.file("│ Gate seek EPC..\n");
               reader_state->n_samples_to_ungate = (EPC_BITS + TAG_PREAMBLE_BITS + EXTRA_BITS) * n_samples_TAG_BIT;
+              window_mode = DECODER_DECODE_EPC;
+              for(int c = 0; c < n_channels; c++)
+                channels[c]->seek_reset(n_samples_search_track);
               reader_state->gate_status = GATE_SEEK;
-              avg_iq = gr_complex(0,0);
-              n_samples = 0;
-              amp_pos_threshold = 0;
-              amp_neg_threshold = 0;
-              max_count = MAX_SEARCH_TRACK;
-            }
-
-            //set reader decoder to decoder preambled version or framsync version
-            if(reader_state->reader_sent_status == PREAMBLE)
-              decoder->set_preamble();
-            else if(reader_state->reader_sent_status == FRAME_SYNC)
-              decoder->set_framesync();
-
-            sample -= avg_dc;
-            gate_log_samples.push_back(sample);
+              break;
 
             //start gating
-
-            //Calculating Average IQ
-            if(reader_state->gate_status == GATE_SEEK)
-            {
-              n_samples++;  //count processed sample number of this mode
-
-              if(--max_count <= 0){
-                gate_fail();
-                number_samples_consumed = i-1;
-                break;
-              }else if(n_samples < (int)(n_samples_T1 * 0.4)){
-                //add for average iq amplitude
-                avg_iq += sample;
-              }else if(n_samples == (int)(n_samples_T1 * 0.4)){
-                //get average iq amplitude in here
-                avg_iq /= n_samples;
-                log << "| AVG amp : " <<avg_iq<<std::endl;
-                log << "| FIND first neg amp"<<std::endl;
-
-                amp_pos_threshold = abs(avg_iq) * AMP_POS_THRESHOLD_RATE;
-                amp_neg_threshold = abs(avg_iq) * AMP_NEG_THRESHOLD_RATE;
-
-                reader_state->gate_status = GATE_TRACK;
-
-                signal_state = POS_EDGE;
-                num_pulses = 0;
-                n_samples = 0;
-              }
-            }
-            else if(reader_state->gate_status == GATE_TRACK)
-            {
-              n_samples++;  //count processed sample number of this mode
-
-              if(--max_count <= 0)
-              {//log<<std::endl;
-                log<<"GATE TRACK"<<std::endl;
-                log<<"abs value : "<<abs(sample)<<std::endl;
-
-                if(signal_state == POS_EDGE) log<<"signal_state : POS_EDGE"<<std::endl;
-                else if(signal_state == NEG_EDGE)  log<<"signal_state : NEG_EDGE"<<std::endl;
-                log<<"num pulse : "<<num_pulses<<std::endl;
-                gate_fail();
-                number_samples_consumed = i-1;
-                break;
-              }//og<<sample<<" ";
-              if((signal_state == NEG_EDGE) && (abs(sample) > amp_pos_threshold))
+            //
+            //every channel searches the end of the reader command on its own,
+            //the gate opens at the earliest channel which finds it
+            case GATE_SEEK:
               {
-                int bit_num = decoder->down_pulse(n_samples);
-                //if we decode bits as much as we needed
-                if(bit_num == reader_state->sent_bit.size())
+                pool.run(n_channels, [&](int c) {
+                    const gr_complex * chunk_in = (const gr_complex *)input_items[c] + number_samples_consumed;
+                    channel_used[c] = channels[c]->search(chunk_in, n);
+                    });
+
+                bool opened = false;
+                bool searching = false;
+                used = n;
+                for(int c = 0; c < n_channels; c++)
                 {
-                  if(decoder->get_bits() != reader_state->sent_bit) //if decode failed go back to GATE_SEEK
-                    reader_state->gate_status = GATE_SEEK;
-                  else  //if we successfully decode, go to GATE_READY
+                  if(channels[c]->status == GATE_OPEN)
                   {
-                    reader_state->gate_status = GATE_READY;
-                    max_count = MAX_SEARCH_READY;
-                    n_samples = 0;
+                    //the window starts where the earliest channel opened
+                    if(!opened || channel_used[c] < used) window_gap = channels[c]->samples_after_command();
+                    opened = true;
+                    used = std::min(used, channel_used[c]);
                   }
+                  else if(channels[c]->status != GATE_CLOSED)
+                    searching = true;
                 }
 
-                signal_state = POS_EDGE;
-                n_samples = 0;
-              }
-              else if((signal_state == POS_EDGE) && (abs(sample) < amp_neg_threshold))
-              {
-                decoder->up_pulse(n_samples);
+                for(int c = 0; c < n_channels; c++)
+                  channels[c]->capture.append(channels[c]->samples(), std::min(used, channel_used[c]), nitems_read(c) + number_samples_consumed);
 
-                signal_state = NEG_EDGE;
-                n_samples = 0;
-              }
-            }
-            else if(reader_state->gate_status == GATE_READY)
-            {
-              if(--max_count <= 0)
-              {//log<<std::endl;
-                log<<"GATE READY"<<std::endl;
-                gate_fail();
-                number_samples_consumed = i-1;
-                break;
-              }//log<<sample<<" ";
-              if(signal_state == POS_EDGE){ 
-                if(abs(sample) < amp_neg_threshold){
-                  signal_state = NEG_EDGE;
-                }else if(n_samples++ > (int)n_samples_T1/2)
-                {//log<<std::endl;
-                  log << "│ Gate open! " << n_samples<<", "<<gate_log_samples.size() << std::endl;
-                  log << "├──────────────────────────────────────────────────" << std::endl;
+                if(opened)
+                {
+                  for(int c = 0; c < n_channels; c++)
+                    if(channels[c]->status != GATE_OPEN) channels[c]->open();
                   reader_state->gate_status = GATE_OPEN;
-                  written = 0;
-                  n_samples = 0;
-                  continue;
+                  window_open_time = latency_clock_ns();
                 }
-              }else if((signal_state == NEG_EDGE) && (abs(sample) > amp_pos_threshold))
-              {
-                n_samples = 0;
-                signal_state = POS_EDGE;
+                else if(!searching)
+                  gate_fail();
               }
-            }
-            else if(reader_state->gate_status == GATE_OPEN)
-            {
-              if(++n_samples > reader_state->n_samples_to_ungate)
+              break;
+
+            case GATE_OPEN:
               {
-                gateLogSave();          
-                number_samples_consumed = i-1;
-                n_samples = 0;
-                reader_state->gate_status = GATE_CLOSED;
-                break;
+                int take = std::min(n, noutput_items - written);
+                bool window_start = channels[0]->at_window_start();
+
+                pool.run(n_channels, [&](int c) {
+                    const gr_complex * chunk_in = (const gr_complex *)input_items[c] + number_samples_consumed;
+                    gr_complex * out = (gr_complex *)output_items[c] + written;
+                    channel_used[c] = channels[c]->gate_open(chunk_in, take, out);
+                    channels[c]->capture.append(out, channel_used[c], nitems_read(c) + number_samples_consumed);
+                    });
+
+                //the channels are open together, they emit the same number of samples
+                used = channel_used[0];
+                written += used;
+
+                if(window_start && used)
+                {
+                  window_index = nitems_read(0) + number_samples_consumed;
+                  add_slot_tag(slot_sof_key(), nitems_written(0) + written - used);
+                }
+
+                if(channels[0]->status == GATE_CLOSED)
+                {
+                  reader_state->gate_status = GATE_CLOSED;
+                  add_slot_tag(slot_eof_key(), nitems_written(0) + written - 1);
+                  gateLogSave(CAPTURE_GATE_OPEN);
+                }
               }
-              out[written++] = sample;
-            }
+              break;
+
+            default:
+              used = n;
           }
-        } //end of "gate_status != GATE_CLOSE"
-        else
-          iq_count += number_samples_consumed;
 
-        log.close();
+          number_samples_consumed += used;
+          iq_count += used;
+
+          //the rest of the open window is emitted in the next call when the output buffer is full
+          if((reader_state->gate_status == GATE_OPEN) && (written >= noutput_items)) break;
+        } //end of "gate_status != GATE_CLOSE"
 
         consume_each(number_samples_consumed);
         return written;
       }
 
-    void gate_impl::gate_fail(void)
+    gate_impl::gate_channel::gate_channel(int id, int sample_rate, const link_profile & profile, const reader_context & context)
+      : id(id), reader_state(context.state()), sample_rate(sample_rate),
+      n_samples_T1(profile.samples(profile.t1, sample_rate)), n_samples_TAG_BIT(profile.samples(profile.tpri, sample_rate)),
+      n_samples_search_ready(profile.samples(profile.search_ready, sample_rate)), n_samples_search_seek(profile.samples(profile.search_seek, sample_rate)),
+      n_samples(0), avg_dc(0,0), dc_residual(0,0), dc_residual_len(0), num_pulses(0), status(GATE_START),
+      log(context.file_path(log_file_path)),
+      capture(id ? context.file_path(gate_capture_file_path) + "_" + std::to_string(id) : context.file_path(gate_capture_file_path),
+          GATE_CAPTURE ? profile.samples(profile.search_track + profile.search_ready, sample_rate) + (EPC_BITS + TAG_PREAMBLE_BITS + EXTRA_BITS) * n_samples_TAG_BIT : 0,
+          GATE_CAPTURE_FILE_SIZE)
     {
-      log << "│ Gate search FAIL!" << std::endl;
+      //the command pulse bounds are built once for the profile
+      decoder = new reader_decoder(profile.samples(profile.delim, sample_rate), profile.samples(profile.pw, sample_rate),
+          profile.samples(profile.trcal, sample_rate), profile.samples(profile.rtcal, sample_rate));
+
+      chunk_samples.resize(GATE_CHUNK_SIZE);
+      chunk_magn.resize(GATE_CHUNK_SIZE);
+      chunk_edges.resize(GATE_CHUNK_SIZE);
+      chunk_ones.assign(GATE_CHUNK_SIZE, 1.0f);
+    }
 
-      log<<"| location : "<<iq_count<<std::endl;
-      std::cout << "Gate FAIL!!";
-      reader_state->gate_status = GATE_CLOSED;
+    gate_impl::gate_channel::~gate_channel()
+    {
+      delete decoder;
+    }
 
-      gateLogSave();
-      decoder->reset();
+    int gate_impl::gate_channel::gate_start(const gr_complex * in, int n)
+    {
+      int n_calib = DC_CALIB;
+      int i = std::min(n, n_calib - n_samples);
+
+      //average the first DC_CALIB samples, the reader is silent until they are done
+      avg_dc += sum(in, i);
+      n_samples += i;
 
-      reader_state->reader_stats.cur_slot_number++;
-      if(reader_state->reader_stats.cur_slot_number > reader_state->reader_stats.max_slot_number)
+      if(n_samples >= n_calib)
       {
-        reader_state->reader_stats.cur_inventory_round ++;
-        reader_state->reader_stats.cur_slot_number = 1;
+        avg_dc /= n_calib;
+        log.file("n_samples_TAG_BIT= %d\n", n_samples_TAG_BIT);
+        log.file("Average of first %d amplitudes= (%g,%g)\n", n_calib, avg_dc.real(), avg_dc.imag());
+
+        avg_iq = gr_complex(0,0);
+        n_samples = 0;
+        amp_pos_threshold = 0;
+        amp_neg_threshold = 0;
+        max_count = n_samples_search_seek;
+
+        status = GATE_CLOSED;
+      }
 
-        log << "└──────────────────────────────────────────────────" << std::endl;
-        if(reader_state->reader_stats.cur_inventory_round > MAX_NUM_QUERIES)
+      return i;
+    }
+
+    //runs the search kernels over the chunk until the channel opens or times out
+    int gate_impl::gate_channel::search(const gr_complex * in, int n)
+    {
+      int i = 0;
+
+      while((i < n) && ((status == GATE_SEEK) || (status == GATE_TRACK) || (status == GATE_READY)))
+      {
+        if(max_count <= 1)
         {
-          reader_state->reader_stats.cur_inventory_round--;
-          reader_state->decoder_status = DECODER_TERMINATED;
+          if(status == GATE_TRACK)
+          {
+            log.file("GATE TRACK\n");
+            if(signal_state == POS_EDGE) log.file("signal_state : POS_EDGE\n");
+            else if(signal_state == NEG_EDGE)  log.file("signal_state : NEG_EDGE\n");
+            log.file("num pulse : %d\n", num_pulses);
+          }
+          else if(status == GATE_READY)
+            log.file("GATE READY\n");
+
+          update_dc();
+          status = GATE_CLOSED;
+          break;
+        }
+
+        int m = std::min(n - i, max_count - 1);
+        remove_dc(in + i, &chunk_samples[i], m);
+
+        if(status == GATE_SEEK)
+          i += gate_seek(&chunk_samples[i], m);
+        else
+        {
+          volk_32fc_magnitude_squared_32f(&chunk_magn[i], &chunk_samples[i], m);
+          if(status == GATE_TRACK)
+            i += gate_track(&chunk_samples[i], &chunk_magn[i], m);
+          else
+          {
+            int k = gate_ready(&chunk_magn[i], m, i);
+            n_samples_command_end += k;
+            i += k;
+          }
         }
-        else reader_state->gen2_logic_status = SEND_QUERY;
       }
-      else
+
+      return i;
+    }
+
+    //Calculating Average IQ
+    int gate_impl::gate_channel::gate_seek(const gr_complex * samples, int n)
+    {
+      int avg_len = (int)(n_samples_T1 * 0.4);
+      int take = std::min(n, avg_len - n_samples);
+
+      for(int i = 0; i < take; i++)
+        avg_iq += samples[i];
+      n_samples += take;
+      max_count -= take;
+
+      if(n_samples >= avg_len)
+      {
+        //get average iq amplitude in here
+        avg_iq /= n_samples;
+        log.file("| AVG amp : (%g,%g)\n", avg_iq.real(), avg_iq.imag());
+        log.file("| FIND first neg amp\n");
+
+        float avg_amp_sq = std::norm(avg_iq);
+        amp_pos_threshold = avg_amp_sq * AMP_POS_THRESHOLD_RATE * AMP_POS_THRESHOLD_RATE;
+        amp_neg_threshold = avg_amp_sq * AMP_NEG_THRESHOLD_RATE * AMP_NEG_THRESHOLD_RATE;
+
+        status = GATE_TRACK;
+
+        signal_state = POS_EDGE;
+        num_pulses = 0;
+        n_samples = 0;
+      }
+
+      return take;
+    }
+
+    int gate_impl::gate_channel::gate_track(const gr_complex * samples, const float * magn, int n)
+    {
+      int n_edges = find_edges(magn, n, signal_state);
+      int last_edge = -1;
+
+      for(int k = 0; k < n_edges; k++)
+      {
+        int edge = chunk_edges[k];
+        int pulse_len = n_samples + (edge - last_edge);
+
+        last_edge = edge;
+        n_samples = 0;
+
+        if(signal_state == NEG_EDGE)
+        {
+          //the carrier is off for the whole pulse if it started in this chunk
+          if(edge - pulse_len >= 0)
+            track_dc(samples + edge - pulse_len + DC_TRACK_GUARD, pulse_len - 2 * DC_TRACK_GUARD);
+
+          int bit_num = decoder->down_pulse(pulse_len);
+          signal_state = POS_EDGE;
+
+          //if a decoded bit differs from the sent one go back to GATE_SEEK,
+          //the pulses found so far still update the DC offset
+          if(bit_num == reader_decoder::BITS_MISMATCH)
+          {
+            update_dc();
+            max_count -= edge + 1;
+            seek_reset(max_count);
+            return edge + 1;
+          }
+
+          //if we successfully decode all the sent bits, go to GATE_READY
+          if(bit_num == reader_state->sent_bit.size())
+          {
+            update_dc();
+            status = GATE_READY;
+            max_count = n_samples_search_ready;
+            n_samples_command_end = 0;
+            return edge + 1;
+          }
+        }
+        else
+        {
+          decoder->up_pulse(pulse_len);
+          signal_state = NEG_EDGE;
+        }
+      }
+
+      n_samples += n - 1 - last_edge;
+      max_count -= n;
+
+      return n;
+    }
+
+    int gate_impl::gate_channel::gate_ready(const float * magn, int n, int offset)
+    {
+      //the gate opens after the signal stays high for T1/2
+      int open_len = n_samples_T1/2 + 2;
+      int i = 0;
+
+      while(i < n)
+      {
+        if(signal_state == POS_EDGE)
+        {
+          int end = std::min(n, i + open_len - n_samples);
+          int j = i;
+          while((j < end) && (magn[j] >= amp_neg_threshold)) j++;
+          n_samples += j - i;
+
+          if(j < end)
+          {
+            signal_state = NEG_EDGE;
+            i = j + 1;
+          }
+          else
+          {
+            i = j;
+            if(n_samples >= open_len)
+            {
+              log.file("│ Gate open! %d, %d\n", n_samples, capture.size() + offset + i);
+              log.file("├──────────────────────────────────────────────────\n");
+              open();
+              break;
+            }
+          }
+        }
+        else
+        {
+          int j = i;
+          while((j < n) && (magn[j] <= amp_pos_threshold)) j++;
+
+          if(j < n)
+          {
+            n_samples = 0;
+            signal_state = POS_EDGE;
+            i = j + 1;
+          }
+          else
+            i = n;
+        }
+      }
+
+      max_count -= i;
+      return i;
+    }
+
+    //emits the open window straight into the output buffer
+    int gate_impl::gate_channel::gate_open(const gr_complex * in, int n, gr_complex * out)
+    {
+      int take = std::min(n, reader_state->n_samples_to_ungate - n_samples);
+
+      remove_dc(in, out, take);
+      n_samples += take;
+
+      if(n_samples >= reader_state->n_samples_to_ungate)
+      {
+        n_samples = 0;
+        status = GATE_CLOSED;
+      }
+
+      return take;
+    }
+
+    //works on interleaved floats so the loop vectorizes
+    void gate_impl::gate_channel::remove_dc(const gr_complex * in, gr_complex * out, int n)
+    {
+      const float * src = (const float *)in;
+      float * dst = (float *)out;
+      const float dc_re = avg_dc.real();
+      const float dc_im = avg_dc.imag();
+
+      for(int i = 0; i < n; i++)
       {
-        log << "├──────────────────────────────────────────────────" << std::endl;
-        reader_state->gen2_logic_status = SEND_QUERY_REP;
+        dst[2*i]   = src[2*i]   - dc_re;
+        dst[2*i+1] = src[2*i+1] - dc_im;
       }
+    }
 
+    //sum of n samples of a chunk, as a dot product with ones
+    gr_complex gate_impl::gate_channel::sum(const gr_complex * samples, int n)
+    {
+      gr_complex total(0,0);
+      for(int i = 0; i < n; i += GATE_CHUNK_SIZE)
+      {
+        gr_complex part;
+        volk_32fc_32f_dot_prod_32fc(&part, samples + i, &chunk_ones[0], std::min(n - i, GATE_CHUNK_SIZE));
+        total += part;
+      }
+      return total;
     }
 
-    void gate_impl::gateLogSave(void){
-      std::ofstream gate_logger;
+    //adds the n DC removed samples of a carrier-off pulse to the residual of the search
+    void gate_impl::gate_channel::track_dc(const gr_complex * samples, int n)
+    {
+      if(n <= 0) return;
+      dc_residual += sum(samples, n);
+      dc_residual_len += n;
+    }
+
+    //moves avg_dc towards the mean residual of the low pulses of a search,
+    //whether the command was decoded or not
+    //
+    //all the pulses of the search had the same avg_dc removed, so their
+    //residuals are averaged and applied once
+    void gate_impl::gate_channel::update_dc(void)
+    {
+      if(dc_residual_len > 0)
+        avg_dc += dc_residual * (float)(DC_TRACK_RATE / dc_residual_len);
+
+      dc_residual = gr_complex(0,0);
+      dc_residual_len = 0;
+    }
+
+    //finds the threshold crossings (with hysteresis) of the squared magnitudes
+    //and stores their positions in chunk_edges, returns the number of edges
+    int gate_impl::gate_channel::find_edges(const float * magn, int n, SIGNAL_STATE state)
+    {
+      int n_edges = 0;
+      int i = 0;
+
+      while(i < n)
+      {
+        if(state == NEG_EDGE)
+        {
+          while((i < n) && (magn[i] <= amp_pos_threshold)) i++;
+          state = POS_EDGE;
+        }
+        else
+        {
+          while((i < n) && (magn[i] >= amp_neg_threshold)) i++;
+          state = NEG_EDGE;
+        }
 
-      gate_logger.open("gateOpenTracker/"+std::to_string(reader_state->reader_stats.cur_inventory_round), std::ios::out|std::ios::binary);
-      for(int i = 0; i<gate_log_samples.size();i++){
-        gate_logger.write((char*)&gate_log_samples[i], sizeof(gr_complex));
+        if(i == n) break;
+        chunk_edges[n_edges++] = i++;
       }
 
-      gate_log_samples.clear();
-      gate_logger.close();
+      return n_edges;
+    }
+
+    void gate_impl::gate_channel::seek_reset(int max_search)
+    {
+      //set reader decoder to decoder preambled version or framsync version
+      if(reader_state->reader_sent_status == PREAMBLE)
+        decoder->set_preamble();
+      else if(reader_state->reader_sent_status == FRAME_SYNC)
+        decoder->set_framesync();
+      decoder->set_expected_bits(&reader_state->sent_bit);
+      decoder->reset();
+
+      //a new search starts with no residual
+      dc_residual = gr_complex(0,0);
+      dc_residual_len = 0;
+
+      status = GATE_SEEK;
+      avg_iq = gr_complex(0,0);
+      n_samples = 0;
+      amp_pos_threshold = 0;
+      amp_neg_threshold = 0;
+      max_count = max_search;
+    }
+
+    void gate_impl::gate_channel::open(void)
+    {
+      status = GATE_OPEN;
+      n_samples = 0;
+    }
+
+    void gate_impl::gate_fail(void)
+    {
+      log.file("│ Gate search FAIL!\n");
+
+      log.file("| location : %u\n", iq_count);
+      log.console("Gate FAIL!!");
+      reader_state->gate_status = GATE_CLOSED;
+
+      gateLogSave(CAPTURE_GATE_FAIL);
+      reader_state->reader_stats.n_results[RESULT_GATE_FAIL].add();
+
+      //the reader command was not decoded, so nothing is known of the slot,
+      //unless the tag already answered it with an RN16 and was alone
+      if(end_slot(reader_state, window_mode == DECODER_DECODE_RN16 ? SLOT_UNKNOWN : SLOT_SINGLE))
+        log.file("└──────────────────────────────────────────────────\n");
+      else
+        log.file("├──────────────────────────────────────────────────\n");
+
+    }
+
+    //tags an output sample of every channel with the window of the current slot
+    void gate_impl::add_slot_tag(const pmt::pmt_t & key, uint64_t offset)
+    {
+      slot_window window;
+      window.round  = reader_state->reader_stats.cur_inventory_round;
+      window.slot   = reader_state->reader_stats.cur_slot_number;
+      window.mode   = window_mode;
+      window.index  = window_index;
+      window.length = reader_state->n_samples_to_ungate;
+      window.gap    = window_gap;
+      window.open_time = window_open_time;
+
+      pmt::pmt_t value = slot_window_to_pmt(window);
+      for(int c = 0; c < n_channels; c++)
+        add_item_tag(c, offset, key, value);
+    }
+
+    void gate_impl::gateLogSave(CAPTURE_OUTCOME outcome)
+    {
+      for(int c = 0; c < n_channels; c++)
+        channels[c]->capture.commit(reader_state->reader_stats.cur_inventory_round, reader_state->reader_stats.cur_slot_number, outcome);
     }
   } // namespace rfid
 } // namespace gr
@@ -24,6 +24,10 @@
 #include <rfid/gate.h>
 #include <vector>
 #include "rfid/global_vars.h"
+#include "logger.h"
+#include "capture_store.h"
+#include "slot_tags.h"
+#include "worker_pool.h"
 #include <fstream>
 
 
@@ -32,60 +36,151 @@ namespace gr {
     class gate_impl : public gate
     {
       private:
+        reader_context::sptr context;
+        READER_STATE * reader_state;  // state of the chain, owned by the context
+
         GATE_STATUS     prev_gate_status = GATE_CLOSED;
 
         enum SIGNAL_STATE {NEG_EDGE, POS_EDGE};
 
-        int n_samples, n_samples_T1, n_samples_TAG_BIT, n_samples_PW, n_samples_RTCAL, n_samples_TRCAL, n_samples_DELIM;
+        int n_samples_T1, n_samples_TAG_BIT, n_samples_PW, n_samples_RTCAL, n_samples_TRCAL, n_samples_DELIM;
+        int n_samples_search_track;
         int sample_rate;
-
-        gr_complex avg_iq;
-        gr_complex avg_dc;
+        int n_channels;
 
         unsigned int iq_count = 0;
-        int max_count = 0;
-        int num_pulses;
-
-        float amp_pos_threshold = 0;
-        float amp_neg_threshold = 0;
 
-        std::vector<uint8_t> reader_signal_decode(const gr_complex * in_data, int * read_idx, int expected_bit_num);
-        uint8_t decode_onebit(const gr_complex * in_data, int * read_idx);
+        logger log;
 
-        SIGNAL_STATE signal_state;
+        DECODER_STATUS window_mode = DECODER_DECODE_RN16;  // kind of reply the next open window carries
+        uint64_t window_index = 0;  // absolute input index of the open window
+        int window_gap = 0;         // samples from the end of the reader command to the open window
+        int64_t window_open_time = 0;
+        void add_slot_tag(const pmt::pmt_t & key, uint64_t offset);
 
-        std::ofstream log;
-        std::vector<gr_complex> gate_log_samples;
+        void gateLogSave(CAPTURE_OUTCOME outcome);
 
-        void gateLogSave(void);
+        // the per-channel DSP runs on this pool, one task per channel
+        worker_pool pool;
 
         class reader_decoder
         {
           private:
-            enum Decode_State {DELIMITER, DATA0, RTCAL, TRCAL, DATAS} decode_state;
+            enum Decode_State {DELIMITER, DATA0, RTCAL, TRCAL, DATAS, N_DECODE_STATES} decode_state;
+
+            // integer pulse length bounds, [min_len, max_len]
+            struct pulse_bounds
+            {
+              int min_len, max_len;
+              bool contains(int pulse_len) const { return (min_len <= pulse_len) && (pulse_len <= max_len); }
+            };
+
+            pulse_bounds up_table[N_DECODE_STATES];
+            pulse_bounds down_table[N_DECODE_STATES];
+            pulse_bounds data1_bounds;
+            Decode_State next_state[2][N_DECODE_STATES];  // [is_preamble][state]
+
             bool is_preamble = true;
             bool up_down_state;
-            std::vector<uint8_t> decoded_bits;
+            int n_bits;
             int8_t guess_bit;
+            const gen2_bits * expected_bits;
 
             const int n_samples_DELIM, n_samples_PW, n_samples_TRCAL, n_samples_RTCAL;
 
-            bool check_length(int pulse_len, int expected_len, double tolerant_rate);
-            void go_next_decode_state(void);
+            static pulse_bounds make_bounds(int expected_len);
 
           public:
+            // returned by down_pulse when a decoded bit differs from the expected one
+            static const int BITS_MISMATCH = -1;
+
             reader_decoder(int n_samples_DELIM, int n_samples_PW, int n_samples_TRCAL, int n_samples_RTCAL);
             int up_pulse(int pulse_len);
             int down_pulse(int pulse_len);
 
-            std::vector<uint8_t> get_bits(void);
             void set_preamble(void);
             void set_framesync(void);
+            void set_expected_bits(const gen2_bits * bits);
+
+            void reset(void);
+        };
+
+        // gate state of one RX channel
+        //
+        // Every channel calibrates its own DC offset and searches the reader
+        // command on its own samples. The gate opens all channels together at
+        // the first channel which finds the end of the command.
+        class gate_channel
+        {
+          private:
+            int id;
+            READER_STATE * reader_state;
+            int sample_rate, n_samples_T1, n_samples_TAG_BIT;
+            int n_samples_search_ready, n_samples_search_seek;
+
+            int n_samples;
+            gr_complex avg_iq;
+            gr_complex avg_dc;
+            gr_complex dc_residual;  // sum of the carrier-off samples of the current search
+            int dc_residual_len;
+
+            int max_count = 0;
+            int num_pulses;
+            int n_samples_command_end = 0;  // samples searched since the end of the reader command
+
+            // thresholds are kept squared so edges can be found on |x|^2 without a sqrt
+            float amp_pos_threshold = 0;
+            float amp_neg_threshold = 0;
+
+            // per-chunk work buffers (DC removed samples, squared magnitudes, edge positions)
+            std::vector<gr_complex> chunk_samples;
+            std::vector<float> chunk_magn;
+            std::vector<int> chunk_edges;
+            std::vector<float> chunk_ones;  // taps of the sums
+
+            SIGNAL_STATE signal_state;
+
+            reader_decoder * decoder;
+
+            // per-state chunk kernels, each returns the number of samples it used
+            int gate_seek(const gr_complex * samples, int n);
+            int gate_track(const gr_complex * samples, const float * magn, int n);
+            int gate_ready(const float * magn, int n, int offset);
+
+            void remove_dc(const gr_complex * in, gr_complex * out, int n);
+            gr_complex sum(const gr_complex * samples, int n);
+            void track_dc(const gr_complex * samples, int n);
+            void update_dc(void);
+            int find_edges(const float * magn, int n, SIGNAL_STATE state);
+
+          public:
+            // GATE_START, GATE_SEEK/TRACK/READY while searching, GATE_OPEN,
+            // GATE_CLOSED once the window is done or the search timed out
+            GATE_STATUS status;
+
+            logger log;
+            capture_store capture;
+
+            gate_channel(int id, int sample_rate, const link_profile & profile, const reader_context & context);
+            ~gate_channel();
+
+            int gate_start(const gr_complex * in, int n);
+            int search(const gr_complex * in, int n);
+            int gate_open(const gr_complex * in, int n, gr_complex * out);
+
+            void seek_reset(int max_search);
+            void open(void);
+
+            const gr_complex * samples(void) const { return &chunk_samples[0]; }
+            bool at_window_start(void) const { return n_samples == 0; }
+            int samples_after_command(void) const { return n_samples_command_end; }
+        };
+
+        std::vector<gate_channel *> channels;
+        std::vector<int> channel_used;  // samples used by every channel in the current chunk
 
-            int reset(void);
-        } * decoder;
       public:
-        gate_impl(int sample_rate);
+        gate_impl(reader_context::sptr context, int sample_rate, int n_channels, const link_profile & profile);
         ~gate_impl();
 
         void forecast (int noutput_items, gr_vector_int &ninput_items_required);
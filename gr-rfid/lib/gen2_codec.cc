@@ -0,0 +1,267 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/gen2_codec.h>
+
+#define CRC5_POLY   (0x09 << 3)  // x^5 + x^3 + 1, kept in the top 5 bits of a byte
+#define CRC5_PRESET (0x09 << 3)
+#define CRC16_POLY   0x1021
+#define CRC16_PRESET 0xFFFF
+
+namespace gr
+{
+  namespace rfid
+  {
+    namespace
+    {
+      // CRC of every byte value, built once
+      struct crc_tables
+      {
+        uint8_t crc5[256];
+        uint16_t crc16[256];
+
+        crc_tables(void)
+        {
+          for(int i = 0; i < 256; i++)
+          {
+            uint8_t c5 = i;
+            uint16_t c16 = i << 8;
+            for(int j = 0; j < 8; j++)
+            {
+              c5 = (c5 & 0x80) ? (c5 << 1) ^ CRC5_POLY : (c5 << 1);
+              c16 = (c16 & 0x8000) ? (c16 << 1) ^ CRC16_POLY : (c16 << 1);
+            }
+            crc5[i] = c5;
+            crc16[i] = c16;
+          }
+        }
+      };
+
+      const crc_tables tables;
+    }
+
+    uint8_t gen2_crc5(const gen2_bits & bits, int n)
+    {
+      const uint8_t * data = bits.bytes();
+      uint8_t crc = CRC5_PRESET;
+
+      // whole bytes through the table, the rest bit by bit
+      int n_bytes = n / 8;
+      for(int i = 0; i < n_bytes; i++)
+        crc = tables.crc5[crc ^ data[i]];
+
+      for(int i = n_bytes * 8; i < n; i++)
+      {
+        crc ^= bits.bit(i) << 7;
+        crc = (crc & 0x80) ? (crc << 1) ^ CRC5_POLY : (crc << 1);
+      }
+
+      return crc >> 3;
+    }
+
+    uint16_t gen2_crc16(const gen2_bits & bits, int n)
+    {
+      const uint8_t * data = bits.bytes();
+      uint16_t crc = CRC16_PRESET;
+
+      int n_bytes = n / 8;
+      for(int i = 0; i < n_bytes; i++)
+        crc = (crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]];
+
+      for(int i = n_bytes * 8; i < n; i++)
+      {
+        crc ^= bits.bit(i) << 15;
+        crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLY : (crc << 1);
+      }
+
+      return ~crc;
+    }
+
+    void gen2_append_crc5(gen2_bits * bits)
+    {
+      bits->push(gen2_crc5(*bits, bits->size()), 5);
+    }
+
+    void gen2_append_crc16(gen2_bits * bits)
+    {
+      bits->push(gen2_crc16(*bits, bits->size()), 16);
+    }
+
+    bool gen2_check_crc16(const gen2_bits & bits, int n)
+    {
+      if(n < 16 || n > bits.size()) return false;
+      return gen2_crc16(bits, n - 16) == bits.get(n - 16, 16);
+    }
+
+    // change of the CRC-16 syndrome of a reply of n bits when bit i is flipped
+    static uint16_t crc16_flip_syndrome(int n, int i)
+    {
+      // a received CRC bit changes the syndrome directly
+      if(i >= n - 16) return 1 << (n - 1 - i);
+
+      // a data bit is a one followed by zeros through a zero preset register
+      uint16_t crc = CRC16_POLY;
+      for(int j = i + 1; j < n - 16; j++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLY : (crc << 1);
+      return crc;
+    }
+
+    int gen2_repair_crc16(gen2_bits * bits, int n, const float * confidence, int n_candidates, float max_confidence)
+    {
+      if(n < 16 || n > bits->size()) return -1;
+      if(n_candidates > n) n_candidates = n;
+      if(n_candidates > 16) n_candidates = 16;
+
+      uint16_t syndrome = gen2_crc16(*bits, n - 16) ^ bits->get(n - 16, 16);
+      if(syndrome == 0) return 0;
+
+      // the weak bits, too many of them and the reply is not worth a try
+      int candidate[16];
+      int n_found = 0;
+      for(int i = 0; i < n; i++)
+      {
+        if(confidence[i] >= max_confidence) continue;
+        if(n_found == n_candidates) return -1;
+        candidate[n_found++] = i;
+      }
+
+      uint16_t flip_syndrome[16];
+      for(int k = 0; k < n_found; k++)
+        flip_syndrome[k] = crc16_flip_syndrome(n, candidate[k]);
+
+      // gray code order, each step flips one candidate
+      uint32_t pattern = 0;
+      for(uint32_t step = 1; step < (1u << n_found); step++)
+      {
+        int k = __builtin_ctz(step);
+        pattern ^= 1u << k;
+        syndrome ^= flip_syndrome[k];
+
+        if(syndrome == 0)
+        {
+          int n_flipped = 0;
+          for(int j = 0; j < n_found; j++)
+          {
+            if(pattern & (1u << j))
+            {
+              bits->flip(candidate[j]);
+              n_flipped++;
+            }
+          }
+          return n_flipped;
+        }
+      }
+
+      return -1;
+    }
+
+    void gen2_encode_query(const gen2_query & query, gen2_bits * out)
+    {
+      out->clear();
+      out->push(GEN2_QUERY_CODE, 4);
+      out->push(query.dr, 1);
+      out->push(query.m, 2);
+      out->push(query.trext, 1);
+      out->push(query.sel, 2);
+      out->push(query.session, 2);
+      out->push(query.target, 1);
+      out->push(query.q, 4);
+      gen2_append_crc5(out);
+    }
+
+    void gen2_encode_query_rep(int session, gen2_bits * out)
+    {
+      out->clear();
+      out->push(GEN2_QUERY_REP_CODE, 2);
+      out->push(session, 2);
+    }
+
+    void gen2_encode_ack(uint16_t rn16, gen2_bits * out)
+    {
+      out->clear();
+      out->push(GEN2_ACK_CODE, 2);
+      out->push(rn16, 16);
+    }
+
+    void gen2_encode_nak(gen2_bits * out)
+    {
+      out->clear();
+      out->push(GEN2_NAK_CODE, 8);
+    }
+
+    void gen2_encode_query_adjust(int session, GEN2_Q_UPDN updn, gen2_bits * out)
+    {
+      out->clear();
+      out->push(GEN2_QUERY_ADJUST_CODE, 4);
+      out->push(session, 2);
+      out->push(updn, 3);
+    }
+
+    bool gen2_decode_query(const gen2_bits & bits, gen2_query * query)
+    {
+      if(bits.size() != GEN2_QUERY_BITS || bits.get(0, 4) != GEN2_QUERY_CODE) return false;
+      if(gen2_crc5(bits, GEN2_QUERY_BITS - 5) != bits.get(GEN2_QUERY_BITS - 5, 5)) return false;
+
+      query->dr      = bits.get(4, 1);
+      query->m       = bits.get(5, 2);
+      query->trext   = bits.get(7, 1);
+      query->sel     = bits.get(8, 2);
+      query->session = bits.get(10, 2);
+      query->target  = bits.get(12, 1);
+      query->q       = bits.get(13, 4);
+      return true;
+    }
+
+    bool gen2_decode_query_rep(const gen2_bits & bits, int * session)
+    {
+      if(bits.size() != GEN2_QUERY_REP_BITS || bits.get(0, 2) != GEN2_QUERY_REP_CODE) return false;
+      *session = bits.get(2, 2);
+      return true;
+    }
+
+    bool gen2_decode_ack(const gen2_bits & bits, uint16_t * rn16)
+    {
+      if(bits.size() != GEN2_ACK_BITS || bits.get(0, 2) != GEN2_ACK_CODE) return false;
+      *rn16 = bits.get(2, 16);
+      return true;
+    }
+
+    bool gen2_decode_nak(const gen2_bits & bits)
+    {
+      return (bits.size() == GEN2_NAK_BITS) && (bits.get(0, 8) == GEN2_NAK_CODE);
+    }
+
+    bool gen2_decode_query_adjust(const gen2_bits & bits, int * session, GEN2_Q_UPDN * updn)
+    {
+      if(bits.size() != GEN2_QUERY_ADJUST_BITS || bits.get(0, 4) != GEN2_QUERY_ADJUST_CODE) return false;
+
+      uint32_t value = bits.get(6, 3);
+      if(value != GEN2_Q_UNCHANGED && value != GEN2_Q_DECREMENT && value != GEN2_Q_INCREMENT) return false;
+
+      *session = bits.get(4, 2);
+      *updn = (GEN2_Q_UPDN)value;
+      return true;
+    }
+  }
+}
@@ -29,32 +29,110 @@
 namespace gr {
   namespace rfid {
 
-    READER_STATE * reader_state;
-
-    void initialize_reader_state()
+    void initialize_reader_state(READER_STATE * reader_state)
     {
-      reader_state = new READER_STATE;
-      
-      reader_state-> sent_bit.resize(256);
-      reader_state-> reader_stats.n_queries_sent = 0;
-      reader_state-> reader_stats.n_ack_sent = 0;
-      reader_state-> reader_stats.n_epc_correct = 0;
+      // the counters of reader_stats start at zero
+      reader_state-> reader_stats.tag_reads.reserve(TAG_TABLE_SIZE, TAG_TABLE_UNCONFIRMED);
 
-      std::vector<int>  unique_tags_round;
-      std::map<int,int> tag_reads;
+      reader_state-> run_limits.max_duration_ms = MAX_DURATION_MS;
+      reader_state-> run_limits.max_unique_tags = NUMBER_UNIQUE_TAGS;
+      reader_state-> run_limits.max_queries     = MAX_NUM_QUERIES;
+      reader_state-> run_limits.max_table_tags  = TAG_TABLE_SIZE;
 
       reader_state-> status           = RUNNING;
-      reader_state-> gen2_logic_status= START;
+      reader_state-> gen2_logic_status= IDLE;  // the gate starts the reader once it has calibrated
       reader_state-> gate_status       = GATE_START;
       reader_state-> decoder_status   = DECODER_DECODE_RN16;
       reader_state-> reader_sent_status = PREAMBLE;
 
-      reader_state-> reader_stats.max_slot_number = pow(2,FIXED_Q);
+      reader_state-> reader_stats.q.reset(ADAPTIVE_Q ? INITIAL_Q : FIXED_Q, Q_STEP_C);
+      reader_state-> reader_stats.q_adjust = GEN2_Q_UNCHANGED;
+      reader_state-> reader_stats.max_slot_number = reader_state-> reader_stats.q.n_slots();
 
       reader_state-> reader_stats.cur_inventory_round = 1;
       reader_state-> reader_stats.cur_slot_number     = 1;
+      reader_state-> n_wakes = 0;
 
       gettimeofday (&reader_state-> reader_stats.start, NULL);
     }
+
+    // true once one of the run limits is reached
+    static bool run_limit_reached(const READER_STATE & state)
+    {
+      const RUN_LIMITS & limits = state.run_limits;
+
+      long max_queries = limits.max_queries;
+      if(max_queries && state.reader_stats.n_queries_sent.load() >= (uint64_t)max_queries) return true;
+
+      long max_tags = limits.max_unique_tags;
+      if(max_tags && state.reader_stats.n_tags.load() >= (uint64_t)max_tags) return true;
+
+      long max_duration = limits.max_duration_ms;
+      if(max_duration)
+      {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        long elapsed = (now.tv_sec - state.reader_stats.start.tv_sec) * 1000L + (now.tv_usec - state.reader_stats.start.tv_usec) / 1000;
+        if(elapsed >= max_duration) return true;
+      }
+      return false;
+    }
+
+    void wake_reader(READER_STATE * reader_state)
+    {
+      {
+        std::lock_guard<std::mutex> lock(reader_state-> wake_mutex);
+        reader_state-> n_wakes++;
+      }
+      reader_state-> wake.notify_all();
+    }
+
+    static bool next_slot(READER_STATE * reader_state, SLOT_OUTCOME outcome)
+    {
+      READER_STATS & stats = reader_state-> reader_stats;
+      stats.n_slots[outcome].add();
+
+      // the inventory ends on a slot boundary, the reader sends nothing after it
+      if(run_limit_reached(*reader_state))
+      {
+        reader_state-> status = TERMINATED;
+        reader_state-> decoder_status = DECODER_TERMINATED;
+        return true;
+      }
+
+      // nothing is known of a slot whose command the gate did not see
+      GEN2_Q_UPDN updn = GEN2_Q_UNCHANGED;
+      if(ADAPTIVE_Q && (outcome != SLOT_UNKNOWN)) updn = stats.q.update(outcome);
+
+      stats.cur_slot_number++;
+      if(stats.cur_slot_number > stats.max_slot_number)
+      {
+        // the next round starts with a Query at the current Q
+        stats.cur_inventory_round++;
+        stats.cur_slot_number = 1;
+        stats.max_slot_number = stats.q.n_slots();
+        reader_state-> gen2_logic_status = SEND_QUERY;
+        return true;
+      }
+
+      if(updn != GEN2_Q_UNCHANGED)
+      {
+        // the tags draw new slots from the adjusted Q
+        stats.q_adjust = updn;
+        stats.cur_slot_number = 1;
+        stats.max_slot_number = stats.q.n_slots();
+        reader_state-> gen2_logic_status = SEND_QUERY_ADJUST;
+      }
+      else reader_state-> gen2_logic_status = SEND_QUERY_REP;
+      return false;
+    }
+
+    bool end_slot(READER_STATE * reader_state, SLOT_OUTCOME outcome)
+    {
+      // the reader sends the next command, or finishes
+      bool round_ended = next_slot(reader_state, outcome);
+      wake_reader(reader_state);
+      return round_ended;
+    }
   } /* namespace rfid */
 } /* namespace gr */
@@ -0,0 +1,151 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/latency_histogram.h>
+#include <chrono>
+
+#define LATENCY_MAX_VALUE ((1ull << LATENCY_MAX_BITS) - 1)
+
+namespace gr
+{
+  namespace rfid
+  {
+    int64_t latency_clock_ns(void)
+    {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    latency_histogram::latency_histogram(void)
+    {
+      reset();
+    }
+
+    int latency_histogram::bucket(uint64_t value)
+    {
+      if(value > LATENCY_MAX_VALUE) value = LATENCY_MAX_VALUE;
+      if(value < LATENCY_SUB_BUCKETS) return value;
+
+      // the top LATENCY_SUB_BITS + 1 bits select the bucket
+      int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BITS;
+      return (shift + 1) * LATENCY_SUB_BUCKETS + (int)(value >> shift) - LATENCY_SUB_BUCKETS;
+    }
+
+    uint64_t latency_histogram::bucket_low(int bucket)
+    {
+      if(bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+      int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+      return (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+    }
+
+    uint64_t latency_histogram::bucket_high(int bucket)
+    {
+      if(bucket < LATENCY_SUB_BUCKETS) return bucket;
+
+      int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+      return bucket_low(bucket) + (1ull << shift) - 1;
+    }
+
+    void latency_histogram::record(int64_t value)
+    {
+      uint64_t v = value > 0 ? value : 0;
+
+      counts[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+      n_values.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(v, std::memory_order_relaxed);
+
+      uint64_t cur = min_value.load(std::memory_order_relaxed);
+      while(v < cur && !min_value.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+      cur = max_value.load(std::memory_order_relaxed);
+      while(v > cur && !max_value.compare_exchange_weak(cur, v, std::memory_order_relaxed));
+    }
+
+    void latency_histogram::reset(void)
+    {
+      for(int i = 0; i < LATENCY_N_BUCKETS; i++)
+        counts[i].store(0, std::memory_order_relaxed);
+      n_values.store(0, std::memory_order_relaxed);
+      sum.store(0, std::memory_order_relaxed);
+      min_value.store(UINT64_MAX, std::memory_order_relaxed);
+      max_value.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t latency_histogram::min(void) const
+    {
+      return count() ? min_value.load(std::memory_order_relaxed) : 0;
+    }
+
+    double latency_histogram::mean(void) const
+    {
+      uint64_t n = count();
+      return n ? (double)sum.load(std::memory_order_relaxed) / n : 0;
+    }
+
+    uint64_t latency_histogram::percentile(double p) const
+    {
+      // the counters are read one by one, the total is taken from them
+      uint64_t snapshot[LATENCY_N_BUCKETS];
+      uint64_t total = 0;
+      for(int i = 0; i < LATENCY_N_BUCKETS; i++)
+      {
+        snapshot[i] = counts[i].load(std::memory_order_relaxed);
+        total += snapshot[i];
+      }
+      if(total == 0) return 0;
+
+      uint64_t rank = (uint64_t)(p / 100 * total + 0.5);
+      if(rank < 1) rank = 1;
+      if(rank > total) rank = total;
+
+      uint64_t seen = 0;
+      for(int i = 0; i < LATENCY_N_BUCKETS; i++)
+      {
+        seen += snapshot[i];
+        if(seen >= rank) return std::min(bucket_high(i), max());
+      }
+      return max();
+    }
+
+    void latency_histogram::print_summary(std::ostream & out, double scale) const
+    {
+      out << "n= " << count() << "\tmin= " << min() / scale << "\tmean= " << mean() / scale;
+      out << "\tp50= " << percentile(50) / scale << "\tp90= " << percentile(90) / scale;
+      out << "\tp99= " << percentile(99) / scale << "\tmax= " << max() / scale;
+    }
+
+    void latency_histogram::print_buckets(std::ostream & out, double scale) const
+    {
+      uint64_t total = count();
+      uint64_t seen = 0;
+      for(int i = 0; i < LATENCY_N_BUCKETS; i++)
+      {
+        uint64_t n = counts[i].load(std::memory_order_relaxed);
+        if(n == 0) continue;
+
+        seen += n;
+        out << bucket_low(i) / scale << "\t" << bucket_high(i) / scale << "\t" << n << "\t" << (double)seen / total << std::endl;
+      }
+    }
+  }
+}
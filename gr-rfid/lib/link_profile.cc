@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/link_profile.h>
+#include <rfid/global_vars.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace gr
+{
+  namespace rfid
+  {
+    link_profile::link_profile(void)
+      : link_profile(T_READER_FREQ, PW_D, DR_D)
+    {
+    }
+
+    link_profile::link_profile(int blf, float pw, float dr)
+      : blf(blf), pw(pw), dr(dr)
+    {
+      if(blf <= 0 || pw <= 0)
+        throw std::invalid_argument("link_profile: BLF and PW must be positive");
+
+      // the tags only know the two divide ratios of the Query DR field
+      if(std::fabs(dr - 8) > 1e-3 && std::fabs(dr - 64.0 / 3) > 1e-3)
+        throw std::invalid_argument("link_profile: DR must be 8 or 64/3, got " + std::to_string(dr));
+
+      tpri  = 1e6 / blf;
+      rtcal = 6 * pw;
+      trcal = dr * tpri;
+
+      // the tags derive the BLF from TRcal, which the specification bounds by RTcal
+      if(trcal < 1.1 * rtcal || trcal > 3 * rtcal)
+        throw std::invalid_argument("link_profile: TRcal (" + std::to_string(trcal) + " us) must be within 1.1 to 3 RTcal ("
+            + std::to_string(rtcal) + " us), change BLF or PW");
+      t1    = std::max(rtcal, 10 * tpri);
+      t2    = 20 * tpri;
+      delim = DELIM_D;
+      cw    = CW_D;
+      p_down = P_DOWN_D;
+      rn16  = (int)((RN16_BITS + TAG_PREAMBLE_BITS) * tpri);
+      epc   = (int)((EPC_BITS + TAG_PREAMBLE_BITS) * tpri);
+
+      search_track = SEARCH_TRACK_D;
+      search_ready = SEARCH_READY_D;
+      search_seek  = SEARCH_SEEK_D;
+    }
+  }
+}
@@ -0,0 +1,366 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "logger.h"
+#include "rfid/global_vars.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LOG_WRITER_PERIOD_MS (2)
+
+namespace gr
+{
+  namespace rfid
+  {
+    log_ring::log_ring()
+      : head(0), tail(0), dropped(0)
+    {
+    }
+
+    bool log_ring::push(const log_record & record)
+    {
+      uint32_t h = head.load(std::memory_order_relaxed);
+      if(h - tail.load(std::memory_order_acquire) >= LOG_RING_SIZE)
+      {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      records[h & (LOG_RING_SIZE - 1)] = record;
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool log_ring::pop(log_record & record)
+    {
+      uint32_t t = tail.load(std::memory_order_relaxed);
+      if(t == head.load(std::memory_order_acquire))
+        return false;
+
+      record = records[t & (LOG_RING_SIZE - 1)];
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    uint32_t log_ring::take_dropped(void)
+    {
+      return dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    // background thread which drains the rings of all loggers
+    class log_writer
+    {
+      private:
+        // a log file and the records of its rings waiting to be written
+        struct log_file
+        {
+          std::string path;
+          std::ofstream stream;
+          int n_rings;
+          uint32_t dropped;  // records its rings lost because they were full
+          std::vector<log_record> batch;
+        };
+
+        struct ring_entry
+        {
+          log_ring * ring;
+          log_file * file;
+        };
+
+        std::mutex lifecycle_mutex;   // serializes add/remove (thread start/stop)
+        std::mutex rings_mutex;       // protects rings, files and the batches
+        std::vector<ring_entry> rings;
+        std::vector<log_file *> files;
+        std::vector<log_record> console_batch;
+
+        std::thread thread;
+        std::atomic<bool> running;
+
+        static bool seq_less(const log_record & a, const log_record & b) { return a.seq < b.seq; }
+
+        void take(log_record & record, log_file * file);
+        void write(log_file * file);
+        void format(const log_record & record, std::string & out);
+        void drain(void);
+        void run(void);
+
+      public:
+        log_writer() : running(false) {}
+        ~log_writer();
+
+        void add(log_ring * ring, const std::string & path);
+        void remove(log_ring * ring);
+    };
+
+    static log_writer writer;
+    static std::atomic<uint64_t> log_seq(0);
+
+    uint64_t logger::next_seq(void)
+    {
+      return log_seq.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    logger::logger(const std::string & path)
+    {
+      ring = new log_ring;
+      writer.add(ring, path);
+    }
+
+    logger::~logger()
+    {
+      writer.remove(ring);
+      delete ring;
+    }
+
+    void log_writer::add(log_ring * ring, const std::string & path)
+    {
+      std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mutex);
+      {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+
+        // the loggers of a chain share its file
+        log_file * file = NULL;
+        for(size_t i = 0; i < files.size() && !file; i++)
+          if(files[i]->path == path) file = files[i];
+
+        if(!file)
+        {
+          file = new log_file;
+          file->path = path;
+          file->stream.open(path.c_str(), std::ios::app);
+          file->n_rings = 0;
+          file->dropped = 0;
+          files.push_back(file);
+        }
+        file->n_rings++;
+
+        ring_entry entry = {ring, file};
+        rings.push_back(entry);
+      }
+
+      if(!running)
+      {
+        running = true;
+        thread = std::thread(&log_writer::run, this);
+      }
+    }
+
+    void log_writer::remove(log_ring * ring)
+    {
+      std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mutex);
+      bool stop = false;
+      {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for(size_t i = 0; i < rings.size(); i++)
+        {
+          if(rings[i].ring != ring) continue;
+          log_file * file = rings[i].file;
+
+          // the remaining records of the ring are moved to the batches before it goes away
+          log_record record;
+          while(ring->pop(record)) take(record, file);
+          file->dropped += ring->take_dropped();
+          rings.erase(rings.begin() + i);
+
+          // the last logger of a file writes what is left of it and closes it
+          if(--file->n_rings == 0)
+          {
+            write(file);
+            files.erase(std::remove(files.begin(), files.end(), file), files.end());
+            delete file;
+          }
+          break;
+        }
+        stop = rings.empty();
+      }
+
+      if(stop)
+      {
+        running = false;
+        if(thread.joinable()) thread.join();
+      }
+    }
+
+    // a logger still held at exit (e.g. by the python top block) leaves the
+    // thread running when the static writer goes away
+    log_writer::~log_writer()
+    {
+      std::lock_guard<std::mutex> lifecycle_lock(lifecycle_mutex);
+      running = false;
+      if(thread.joinable()) thread.join();
+      for(size_t i = 0; i < files.size(); i++)
+        delete files[i];
+    }
+
+    void log_writer::run(void)
+    {
+      while(running)
+      {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITER_PERIOD_MS));
+      }
+      drain();
+    }
+
+    void log_writer::take(log_record & record, log_file * file)
+    {
+      if(record.target == LOG_FILE) file->batch.push_back(record);
+      else console_batch.push_back(record);
+    }
+
+    // formats the batch of a file in the order the records were produced
+    void log_writer::write(log_file * file)
+    {
+      std::string out;
+      std::sort(file->batch.begin(), file->batch.end(), seq_less);
+      for(size_t i = 0; i < file->batch.size(); i++)
+        format(file->batch[i], out);
+      file->batch.clear();
+
+      if(file->dropped)
+        out += "[log] " + std::to_string(file->dropped) + " records dropped\n";
+      file->dropped = 0;
+
+      if(!out.empty())
+      {
+        file->stream << out;
+        file->stream.flush();
+      }
+    }
+
+    void log_writer::drain(void)
+    {
+      std::string console_out;
+
+      {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        log_record record;
+
+        for(size_t i = 0; i < rings.size(); i++)
+        {
+          while(rings[i].ring->pop(record)) take(record, rings[i].file);
+          rings[i].file->dropped += rings[i].ring->take_dropped();
+        }
+
+        for(size_t i = 0; i < files.size(); i++)
+          write(files[i]);
+
+        // records of different blocks are written in the order they were produced
+        std::sort(console_batch.begin(), console_batch.end(), seq_less);
+        for(size_t i = 0; i < console_batch.size(); i++)
+          format(console_batch[i], console_out);
+        console_batch.clear();
+      }
+
+      if(!console_out.empty())
+        std::cout << console_out << std::flush;
+    }
+
+    void log_writer::format(const log_record & record, std::string & out)
+    {
+      const char * p = record.fmt;
+      int arg_idx = 0;
+      char spec[32];
+      char buf[128];
+
+      while(*p)
+      {
+        if(*p != '%')
+        {
+          out += *p++;
+          continue;
+        }
+        if(p[1] == '%')
+        {
+          out += '%';
+          p += 2;
+          continue;
+        }
+
+        // flags, width and precision are kept, length modifiers are replaced
+        const char * start = p++;
+        while(*p && strchr("-+ #0123456789.", *p)) p++;
+        int spec_len = std::min((int)(p - start), (int)sizeof(spec) - 3);
+        memcpy(spec, start, spec_len);
+        while(*p && strchr("hlLqjzt", *p)) p++;
+
+        char conv = *p;
+        if(!conv) break;
+        p++;
+
+        if(arg_idx >= record.n_args)
+        {
+          out += "<?>";
+          continue;
+        }
+        const log_arg & arg = record.args[arg_idx++];
+
+        switch(conv)
+        {
+          case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            spec[spec_len] = 'l';
+            spec[spec_len + 1] = conv;
+            spec[spec_len + 2] = '\0';
+            snprintf(buf, sizeof(buf), spec, (arg.type == log_arg::ARG_DOUBLE) ? (long)arg.d : arg.i);
+            out += buf;
+            break;
+
+          case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            spec[spec_len] = conv;
+            spec[spec_len + 1] = '\0';
+            snprintf(buf, sizeof(buf), spec, (arg.type == log_arg::ARG_DOUBLE) ? arg.d : (double)arg.i);
+            out += buf;
+            break;
+
+          case 'c':
+            out += (char)arg.i;
+            break;
+
+          case 's':
+            out += (arg.type == log_arg::ARG_STR) ? arg.s : "<?>";
+            break;
+
+          case 'b':
+            for(int i = 0; i < arg.b.n_bits; i++)
+            {
+              if(i % 4 == 0) out += ' ';
+              out += ((arg.b.value >> (arg.b.n_bits - 1 - i)) & 1) ? '1' : '0';
+            }
+            break;
+
+          default:
+            out += "<?>";
+        }
+      }
+    }
+  }
+}
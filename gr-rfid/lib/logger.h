@@ -0,0 +1,147 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_LOGGER_H
+#define INCLUDED_RFID_LOGGER_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Asynchronous logger
+    //
+    // Every block owns a logger. Producers only copy a fixed size record
+    // (format string pointer + arguments) into the block's SPSC ring, so the
+    // scheduler thread never formats, blocks or touches the filesystem.
+    // One background thread drains all rings, formats the records and writes
+    // them to the file of their logger (LOG_FILE) or std::cout (LOG_CONSOLE).
+    // The blocks of a chain log to context.file_path(log_file_path), so the
+    // chains sharing a process keep their logs apart.
+    //
+    // The format string must be a string literal, it is formatted later.
+    // printf conversions are supported (length modifiers are ignored) plus
+    // %b, which prints a log_bits argument as " 0101 1100 ..".
+
+    enum LOG_TARGET {LOG_FILE, LOG_CONSOLE};
+
+    const int LOG_MAX_ARGS  = 6;
+    const int LOG_RING_SIZE = 1024;  // must be a power of two
+
+    struct log_bits
+    {
+      uint32_t value;  // MSB first
+      int n_bits;      // up to 32
+    };
+
+    struct log_arg
+    {
+      enum ARG_TYPE {ARG_INT, ARG_DOUBLE, ARG_STR, ARG_BITS} type;
+      union
+      {
+        long i;
+        double d;
+        const char * s;
+        log_bits b;
+      };
+    };
+
+    struct log_record
+    {
+      uint64_t seq;
+      const char * fmt;
+      LOG_TARGET target;
+      int n_args;
+      log_arg args[LOG_MAX_ARGS];
+    };
+
+    class log_ring
+    {
+      private:
+        log_record records[LOG_RING_SIZE];
+        std::atomic<uint32_t> head;     // next slot to write (producer)
+        std::atomic<uint32_t> tail;     // next slot to read (consumer)
+        std::atomic<uint32_t> dropped;  // records lost because the ring was full
+
+      public:
+        log_ring();
+
+        bool push(const log_record & record);
+        bool pop(log_record & record);
+        uint32_t take_dropped(void);
+    };
+
+    class logger
+    {
+      private:
+        log_ring * ring;
+
+        static inline log_arg make_arg(long v)         { log_arg a; a.type = log_arg::ARG_INT; a.i = v; return a; }
+        static inline log_arg make_arg(int v)          { return make_arg((long)v); }
+        static inline log_arg make_arg(unsigned int v) { return make_arg((long)v); }
+        static inline log_arg make_arg(unsigned long v){ return make_arg((long)v); }
+        static inline log_arg make_arg(double v)       { log_arg a; a.type = log_arg::ARG_DOUBLE; a.d = v; return a; }
+        static inline log_arg make_arg(float v)        { return make_arg((double)v); }
+        static inline log_arg make_arg(const char * v) { log_arg a; a.type = log_arg::ARG_STR; a.s = v; return a; }
+        static inline log_arg make_arg(log_bits v)     { log_arg a; a.type = log_arg::ARG_BITS; a.b = v; return a; }
+
+        static inline void pack(log_record &) {}
+
+        template<typename T, typename... Args>
+          static inline void pack(log_record & record, T first, Args... rest)
+          {
+            record.args[record.n_args++] = make_arg(first);
+            pack(record, rest...);
+          }
+
+        template<typename... Args>
+          inline void push(LOG_TARGET target, const char * fmt, Args... args)
+          {
+            static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+
+            log_record record;
+            record.seq = next_seq();
+            record.fmt = fmt;
+            record.target = target;
+            record.n_args = 0;
+            pack(record, args...);
+
+            ring->push(record);
+          }
+
+        static uint64_t next_seq(void);
+
+      public:
+        logger(const std::string & path);
+        ~logger();
+
+        template<typename... Args>
+          void file(const char * fmt, Args... args) { push(LOG_FILE, fmt, args...); }
+
+        template<typename... Args>
+          void console(const char * fmt, Args... args) { push(LOG_CONSOLE, fmt, args...); }
+    };
+  }
+}
+
+#endif
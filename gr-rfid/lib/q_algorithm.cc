@@ -0,0 +1,64 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/q_algorithm.h>
+#include <algorithm>
+#include <cmath>
+
+namespace gr
+{
+  namespace rfid
+  {
+    q_algorithm::q_algorithm(void)
+    {
+      reset(GEN2_MIN_Q, 0.5);
+    }
+
+    void q_algorithm::reset(float initial_q, float step)
+    {
+      qfp = std::min(std::max(initial_q, (float)GEN2_MIN_Q), (float)GEN2_MAX_Q);
+      c = std::min(std::max(step, 0.0f), 0.5f);
+      cur_q = (int)std::floor(qfp + 0.5);
+    }
+
+    GEN2_Q_UPDN q_algorithm::update(SLOT_OUTCOME outcome)
+    {
+      if(outcome == SLOT_EMPTY) qfp = std::max(qfp - c, (float)GEN2_MIN_Q);
+      else if(outcome == SLOT_COLLISION) qfp = std::min(qfp + c, (float)GEN2_MAX_Q);
+
+      int new_q = (int)std::floor(qfp + 0.5);
+      if(new_q > cur_q)
+      {
+        cur_q++;
+        return GEN2_Q_INCREMENT;
+      }
+      if(new_q < cur_q)
+      {
+        cur_q--;
+        return GEN2_Q_DECREMENT;
+      }
+      return GEN2_Q_UNCHANGED;
+    }
+  }
+}
@@ -0,0 +1,247 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "qa_epc_table.h"
+#include <rfid/epc_table.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // PC + EPC of tag n, followed by the CRC-16 as in a reply
+    static gen2_bits make_reply(uint32_t n)
+    {
+      gen2_bits reply;
+      reply.push(0x3000, 16);
+      reply.push(0xE200, 16);
+      reply.push(0, 32);
+      reply.push(0, 16);
+      reply.push(n, 32);
+      gen2_append_crc16(&reply);
+      return reply;
+    }
+
+    void qa_epc_table::t1_insert()
+    {
+      epc_table table;
+      CPPUNIT_ASSERT_EQUAL(0, table.size());
+
+      gen2_bits reply = make_reply(1);
+      epc_entry * entry = table.add_read(reply, 100, std::complex<float>(0, 2));
+      CPPUNIT_ASSERT(entry != NULL);
+      CPPUNIT_ASSERT_EQUAL(1, table.size());
+      CPPUNIT_ASSERT_EQUAL(1, entry->n_reads);
+      CPPUNIT_ASSERT_EQUAL(0x3000, (int)entry->pc());
+
+      // a second read of the same tag updates its entry
+      entry = table.add_read(reply, 200, std::complex<float>(0, 4));
+      CPPUNIT_ASSERT_EQUAL(1, table.size());
+      CPPUNIT_ASSERT_EQUAL(2, entry->n_reads);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)100, entry->first_seen);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)200, entry->last_seen);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(3.0, entry->mean_corr(), 1e-9);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(M_PI / 2, entry->mean_phase(), 1e-6);
+
+      // a reply shorter than the key is not counted
+      gen2_bits rn16;
+      rn16.push(0xBEEF, 16);
+      CPPUNIT_ASSERT(table.add_read(rn16, 300, 1) == NULL);
+      CPPUNIT_ASSERT_EQUAL(1, table.size());
+
+      table.clear();
+      CPPUNIT_ASSERT_EQUAL(0, table.size());
+      CPPUNIT_ASSERT(table.find(reply) == NULL);
+    }
+
+    void qa_epc_table::t2_lookup()
+    {
+      epc_table table;
+      for(uint32_t n = 0; n < 8; n++)
+        table.add_read(make_reply(n), n, 1);
+
+      for(uint32_t n = 0; n < 8; n++)
+      {
+        const epc_entry * entry = table.find(make_reply(n));
+        CPPUNIT_ASSERT(entry != NULL);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)n, entry->first_seen);
+      }
+
+      // the key is the PC + EPC only, the CRC is not part of it
+      gen2_bits reply = make_reply(3);
+      reply.flip(120);
+      CPPUNIT_ASSERT(table.find(reply) != NULL);
+
+      CPPUNIT_ASSERT(table.find(make_reply(8)) == NULL);
+      reply = make_reply(3);
+      reply.flip(0);
+      CPPUNIT_ASSERT(table.find(reply) == NULL);
+    }
+
+    void qa_epc_table::t3_capacity()
+    {
+      // the table is allocated once for its maximum and keeps every entry up to it
+      epc_table table;
+      table.reserve(1000, 0);
+      int capacity = table.capacity();
+      CPPUNIT_ASSERT(capacity >= 1000);
+      for(uint32_t n = 0; n < 1000; n++)
+        for(int k = 0; k < 2; k++)
+          table.add_read(make_reply(n * 7919), 2 * n + k, 1);
+
+      CPPUNIT_ASSERT_EQUAL(1000, table.size());
+      for(uint32_t n = 0; n < 1000; n++)
+      {
+        const epc_entry * entry = table.find(make_reply(n * 7919));
+        CPPUNIT_ASSERT(entry != NULL);
+        CPPUNIT_ASSERT_EQUAL(2, entry->n_reads);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)(2 * n), entry->first_seen);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)(2 * n + 1), entry->last_seen);
+      }
+
+      // past the maximum the new tags are dropped, the known ones are still counted
+      CPPUNIT_ASSERT(table.add_read(make_reply(1000 * 7919), 3000, 1) == NULL);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, table.dropped());
+      CPPUNIT_ASSERT_EQUAL(3, table.add_read(make_reply(0), 3001, 1)->n_reads);
+      CPPUNIT_ASSERT_EQUAL(1000, table.size());
+
+      // the limit can be raised up to the allocation, the table never grows
+      table.set_max_tags(0);
+      uint32_t n = 1000;
+      while(table.add_read(make_reply(n * 7919), 4000 + n, 1) != NULL) n++;
+      CPPUNIT_ASSERT_EQUAL(capacity, table.size());
+      CPPUNIT_ASSERT_EQUAL(capacity, table.capacity());
+      CPPUNIT_ASSERT(table.find(make_reply(999 * 7919)) != NULL);
+    }
+
+    void qa_epc_table::t4_sorted()
+    {
+      // entries come out in order of first read, whatever their slots
+      epc_table table;
+      uint32_t order[] = {42, 7, 1000, 3, 99, 12345};
+      for(int i = 0; i < 6; i++)
+        table.add_read(make_reply(order[i]), 10 * (i + 1), 1);
+      table.add_read(make_reply(7), 500, 1);
+
+      std::vector<const epc_entry *> sorted = table.sorted();
+      CPPUNIT_ASSERT_EQUAL((size_t)6, sorted.size());
+      for(int i = 0; i < 6; i++)
+      {
+        CPPUNIT_ASSERT_EQUAL((uint64_t)(10 * (i + 1)), sorted[i]->first_seen);
+        CPPUNIT_ASSERT(sorted[i] == table.find(make_reply(order[i])));
+      }
+    }
+
+    void qa_epc_table::t5_repaired()
+    {
+      // a tag only read through repairs is kept but not confirmed
+      epc_table table;
+      table.reserve(256, 256);
+      table.add_read(make_reply(1), 10, 1, true);
+      const epc_entry * entry = table.add_read(make_reply(1), 20, 1, true);
+      CPPUNIT_ASSERT_EQUAL(1, table.size());
+      CPPUNIT_ASSERT_EQUAL(0, table.confirmed());
+      CPPUNIT_ASSERT(!entry->confirmed());
+      CPPUNIT_ASSERT_EQUAL(2, entry->n_repaired);
+
+      // the first clean read confirms it, once
+      table.add_read(make_reply(1), 30, 1);
+      table.add_read(make_reply(1), 40, 1);
+      entry = table.add_read(make_reply(1), 50, 1, true);
+      CPPUNIT_ASSERT_EQUAL(1, table.confirmed());
+      CPPUNIT_ASSERT(entry->confirmed());
+      CPPUNIT_ASSERT_EQUAL(5, entry->n_reads);
+      CPPUNIT_ASSERT_EQUAL(3, entry->n_repaired);
+
+      table.add_read(make_reply(2), 60, 1);
+      CPPUNIT_ASSERT_EQUAL(2, table.confirmed());
+
+      // the count survives other tags and goes with clear()
+      for(uint32_t n = 100; n < 200; n++)
+        table.add_read(make_reply(n), n, 1, true);
+      CPPUNIT_ASSERT_EQUAL(102, table.size());
+      CPPUNIT_ASSERT_EQUAL(2, table.confirmed());
+      table.clear();
+      CPPUNIT_ASSERT_EQUAL(0, table.confirmed());
+    }
+
+    // PC + EPC of an entry, as a reply
+    static gen2_bits entry_key(const epc_entry * entry)
+    {
+      gen2_bits key;
+      for(int i = 0; i < EPC_KEY_BYTES; i++)
+        key.push(entry->key[i], 8);
+      return key;
+    }
+
+    void qa_epc_table::t6_eviction()
+    {
+      epc_table table;
+      table.reserve(8, 3);
+      for(uint32_t n = 0; n < 4; n++)
+        table.add_read(make_reply(n), n, 1);
+      for(uint32_t n = 100; n < 103; n++)
+        table.add_read(make_reply(n), n - 90, 1, true);
+      CPPUNIT_ASSERT_EQUAL(7, table.size());
+
+      // past max_unconfirmed a repaired read evicts the least recently read unconfirmed tag
+      table.add_read(make_reply(100), 13, 1, true);
+      CPPUNIT_ASSERT(table.add_read(make_reply(103), 14, 1, true) != NULL);
+      CPPUNIT_ASSERT_EQUAL(7, table.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, table.evicted());
+      CPPUNIT_ASSERT(table.find(make_reply(101)) == NULL);
+      CPPUNIT_ASSERT(table.find(make_reply(100)) != NULL);
+
+      // a new tag read clean takes the place of an unconfirmed one in a full table
+      table.add_read(make_reply(4), 15, 1);
+      CPPUNIT_ASSERT(table.add_read(make_reply(5), 16, 1) != NULL);
+      CPPUNIT_ASSERT_EQUAL(8, table.size());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)2, table.evicted());
+      CPPUNIT_ASSERT(table.find(make_reply(102)) == NULL);
+
+      // a new repaired tag in a full table is dropped, the tags read clean are never evicted
+      CPPUNIT_ASSERT(table.add_read(make_reply(104), 17, 1, true) == NULL);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, table.dropped());
+      table.add_read(make_reply(100), 18, 1);
+      CPPUNIT_ASSERT(table.add_read(make_reply(6), 19, 1) != NULL);
+      CPPUNIT_ASSERT(table.add_read(make_reply(7), 20, 1) == NULL);
+      CPPUNIT_ASSERT_EQUAL(8, table.confirmed());
+      for(uint32_t n = 0; n < 7; n++)
+        CPPUNIT_ASSERT(table.find(make_reply(n)) != NULL);
+
+      // the probe chains stay whole through many evictions
+      epc_table busy;
+      busy.reserve(64, 16);
+      srand(4);
+      for(int i = 0; i < 5000; i++)
+        busy.add_read(make_reply(rand() % 200), i, 1, (rand() % 4) != 0);
+      std::vector<const epc_entry *> entries = busy.sorted();
+      CPPUNIT_ASSERT_EQUAL((size_t)busy.size(), entries.size());
+      CPPUNIT_ASSERT(busy.size() - busy.confirmed() <= 16);
+      for(size_t i = 0; i < entries.size(); i++)
+        CPPUNIT_ASSERT(busy.find(entry_key(entries[i])) == entries[i]);
+    }
+  }
+}
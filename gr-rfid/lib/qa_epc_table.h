@@ -0,0 +1,54 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_QA_EPC_TABLE_H
+#define INCLUDED_RFID_QA_EPC_TABLE_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    class qa_epc_table : public CppUnit::TestCase
+    {
+      public:
+        CPPUNIT_TEST_SUITE(qa_epc_table);
+        CPPUNIT_TEST(t1_insert);
+        CPPUNIT_TEST(t2_lookup);
+        CPPUNIT_TEST(t3_capacity);
+        CPPUNIT_TEST(t4_sorted);
+        CPPUNIT_TEST(t5_repaired);
+        CPPUNIT_TEST(t6_eviction);
+        CPPUNIT_TEST_SUITE_END();
+
+      private:
+        void t1_insert();
+        void t2_lookup();
+        void t3_capacity();
+        void t4_sorted();
+        void t5_repaired();
+        void t6_eviction();
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_QA_EPC_TABLE_H */
@@ -0,0 +1,245 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "qa_gen2_codec.h"
+#include <rfid/gen2_codec.h>
+#include <cstdlib>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // bit by bit reference of the CRCs, as in the Gen2 specification
+    static uint8_t ref_crc5(const gen2_bits & bits, int n)
+    {
+      uint8_t crc = 0x09;
+      for(int i = 0; i < n; i++)
+      {
+        int feedback = bits.bit(i) ^ ((crc >> 4) & 1);
+        crc = (crc << 1) & 0x1F;
+        if(feedback) crc ^= 0x09;
+      }
+      return crc;
+    }
+
+    static uint16_t ref_crc16(const gen2_bits & bits, int n)
+    {
+      uint16_t crc = 0xFFFF;
+      for(int i = 0; i < n; i++)
+      {
+        int feedback = bits.bit(i) ^ ((crc >> 15) & 1);
+        crc <<= 1;
+        if(feedback) crc ^= 0x1021;
+      }
+      return ~crc;
+    }
+
+    static void push_string(gen2_bits * bits, const char * s)
+    {
+      for(; *s; s++)
+        bits->push((uint8_t)*s, 8);
+    }
+
+    void qa_gen2_codec::t1_bits()
+    {
+      gen2_bits bits;
+      CPPUNIT_ASSERT_EQUAL(0, bits.size());
+
+      bits.push(1);
+      bits.push(0x5, 3);
+      bits.push(0xABCD, 16);
+      CPPUNIT_ASSERT_EQUAL(20, bits.size());
+      CPPUNIT_ASSERT_EQUAL(1, bits[0]);
+      CPPUNIT_ASSERT_EQUAL(0x5u, bits.get(1, 3));
+      CPPUNIT_ASSERT_EQUAL(0xABCDu, bits.get(4, 16));
+      CPPUNIT_ASSERT_EQUAL(0xDAu, (uint32_t)bits.bytes()[0]);  // 1 101 1010
+
+      // the capacity is fixed, extra bits are dropped
+      for(int i = 0; i < GEN2_MAX_BITS; i++)
+        bits.push(1);
+      CPPUNIT_ASSERT_EQUAL(GEN2_MAX_BITS, bits.size());
+
+      bits.clear();
+      CPPUNIT_ASSERT_EQUAL(0, bits.size());
+      CPPUNIT_ASSERT_EQUAL(0u, bits.get(0, 32));
+    }
+
+    void qa_gen2_codec::t2_crc5()
+    {
+      // check value of CRC-5/EPC-C1G2
+      gen2_bits bits;
+      push_string(&bits, "123456789");
+      CPPUNIT_ASSERT_EQUAL(0x00, (int)gen2_crc5(bits, bits.size()));
+
+      // the byte table matches the bit by bit CRC for every length
+      srand(1);
+      for(int n = 0; n <= 64; n++)
+      {
+        bits.clear();
+        for(int i = 0; i < n; i++)
+          bits.push(rand() & 1);
+        CPPUNIT_ASSERT_EQUAL((int)ref_crc5(bits, n), (int)gen2_crc5(bits, n));
+      }
+    }
+
+    void qa_gen2_codec::t3_crc16()
+    {
+      // check value of CRC-16/GENIBUS, the Gen2 CRC-16
+      gen2_bits bits;
+      push_string(&bits, "123456789");
+      CPPUNIT_ASSERT_EQUAL(0xD64E, (int)gen2_crc16(bits, bits.size()));
+
+      srand(2);
+      for(int n = 0; n <= 144; n++)
+      {
+        bits.clear();
+        for(int i = 0; i < n; i++)
+          bits.push(rand() & 1);
+        CPPUNIT_ASSERT_EQUAL((int)ref_crc16(bits, n), (int)gen2_crc16(bits, n));
+      }
+
+      // a PC + EPC reply with its CRC passes, any flipped bit fails
+      bits.clear();
+      for(int i = 0; i < 112; i++)
+        bits.push(rand() & 1);
+      gen2_append_crc16(&bits);
+      CPPUNIT_ASSERT_EQUAL(128, bits.size());
+      CPPUNIT_ASSERT(gen2_check_crc16(bits, 128));
+
+      for(int i = 0; i < 128; i++)
+      {
+        gen2_bits flipped;
+        for(int j = 0; j < 128; j++)
+          flipped.push(bits[j] ^ (i == j));
+        CPPUNIT_ASSERT(!gen2_check_crc16(flipped, 128));
+      }
+    }
+
+    void qa_gen2_codec::t4_query()
+    {
+      gen2_query query = {1, 2, 1, 3, 2, 1, 9};
+      gen2_bits bits;
+      gen2_encode_query(query, &bits);
+
+      CPPUNIT_ASSERT_EQUAL(GEN2_QUERY_BITS, bits.size());
+      CPPUNIT_ASSERT_EQUAL(GEN2_QUERY_CODE, bits.get(0, 4));
+      CPPUNIT_ASSERT_EQUAL((uint32_t)ref_crc5(bits, 17), bits.get(17, 5));
+
+      gen2_query decoded;
+      CPPUNIT_ASSERT(gen2_decode_query(bits, &decoded));
+      CPPUNIT_ASSERT_EQUAL(query.dr, decoded.dr);
+      CPPUNIT_ASSERT_EQUAL(query.m, decoded.m);
+      CPPUNIT_ASSERT_EQUAL(query.trext, decoded.trext);
+      CPPUNIT_ASSERT_EQUAL(query.sel, decoded.sel);
+      CPPUNIT_ASSERT_EQUAL(query.session, decoded.session);
+      CPPUNIT_ASSERT_EQUAL(query.target, decoded.target);
+      CPPUNIT_ASSERT_EQUAL(query.q, decoded.q);
+
+      // a corrupted Q field fails the CRC-5
+      gen2_bits corrupted;
+      for(int i = 0; i < bits.size(); i++)
+        corrupted.push(bits[i] ^ (i == 14));
+      CPPUNIT_ASSERT(!gen2_decode_query(corrupted, &decoded));
+    }
+
+    void qa_gen2_codec::t5_commands()
+    {
+      gen2_bits bits;
+
+      int session;
+      gen2_encode_query_rep(2, &bits);
+      CPPUNIT_ASSERT_EQUAL(GEN2_QUERY_REP_BITS, bits.size());
+      CPPUNIT_ASSERT(gen2_decode_query_rep(bits, &session));
+      CPPUNIT_ASSERT_EQUAL(2, session);
+
+      uint16_t rn16;
+      gen2_encode_ack(0xBEEF, &bits);
+      CPPUNIT_ASSERT_EQUAL(GEN2_ACK_BITS, bits.size());
+      CPPUNIT_ASSERT_EQUAL(0x1u, bits.get(0, 2));
+      CPPUNIT_ASSERT(gen2_decode_ack(bits, &rn16));
+      CPPUNIT_ASSERT_EQUAL(0xBEEF, (int)rn16);
+      CPPUNIT_ASSERT(!gen2_decode_query_rep(bits, &session));
+
+      gen2_encode_nak(&bits);
+      CPPUNIT_ASSERT_EQUAL(GEN2_NAK_BITS, bits.size());
+      CPPUNIT_ASSERT_EQUAL(0xC0u, bits.get(0, 8));
+      CPPUNIT_ASSERT(gen2_decode_nak(bits));
+
+      GEN2_Q_UPDN updn;
+      gen2_encode_query_adjust(1, GEN2_Q_INCREMENT, &bits);
+      CPPUNIT_ASSERT_EQUAL(GEN2_QUERY_ADJUST_BITS, bits.size());
+      CPPUNIT_ASSERT_EQUAL(0x12Eu, bits.get(0, 9));  // 1001 01 110
+      CPPUNIT_ASSERT(gen2_decode_query_adjust(bits, &session, &updn));
+      CPPUNIT_ASSERT_EQUAL(1, session);
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_INCREMENT, updn);
+      CPPUNIT_ASSERT(!gen2_decode_nak(bits));
+    }
+
+    void qa_gen2_codec::t6_repair()
+    {
+      srand(3);
+      gen2_bits reply;
+      for(int i = 0; i < 112; i++)
+        reply.push(rand() & 1);
+      gen2_append_crc16(&reply);
+
+      float confidence[128];
+      for(int i = 0; i < 128; i++)
+        confidence[i] = 1.0 + (rand() % 100);
+
+      // errors on weak bits, one of them in the CRC field, are repaired
+      gen2_bits received = reply;
+      int errors[] = {5, 77, 120};
+      for(int i = 0; i < 3; i++)
+      {
+        received.flip(errors[i]);
+        confidence[errors[i]] = 0.1 * i;
+      }
+      confidence[40] = 0.5;  // a weak bit which is right
+      CPPUNIT_ASSERT(!gen2_check_crc16(received, 128));
+      CPPUNIT_ASSERT_EQUAL(3, gen2_repair_crc16(&received, 128, confidence, 6, 1.0));
+      CPPUNIT_ASSERT(received == reply);
+
+      // a correct reply is left alone
+      CPPUNIT_ASSERT_EQUAL(0, gen2_repair_crc16(&received, 128, confidence, 6, 1.0));
+
+      // an error on a strong bit is not found and the reply is unchanged
+      received.flip(5);
+      received.flip(60);
+      gen2_bits failed = received;
+      CPPUNIT_ASSERT_EQUAL(-1, gen2_repair_crc16(&received, 128, confidence, 6, 1.0));
+      CPPUNIT_ASSERT(received == failed);
+
+      // with more weak bits than candidates the reply is not tried, even if it could be repaired
+      received.flip(60);
+      failed = received;
+      for(int i = 0; i < 4; i++)
+        confidence[90 + i] = 0.5;
+      CPPUNIT_ASSERT_EQUAL(-1, gen2_repair_crc16(&received, 128, confidence, 6, 1.0));
+      CPPUNIT_ASSERT(received == failed);
+      CPPUNIT_ASSERT_EQUAL(1, gen2_repair_crc16(&received, 128, confidence, 8, 1.0));
+      CPPUNIT_ASSERT(received == reply);
+    }
+  }
+}
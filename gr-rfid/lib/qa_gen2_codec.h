@@ -0,0 +1,54 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_QA_GEN2_CODEC_H
+#define INCLUDED_RFID_QA_GEN2_CODEC_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    class qa_gen2_codec : public CppUnit::TestCase
+    {
+      public:
+        CPPUNIT_TEST_SUITE(qa_gen2_codec);
+        CPPUNIT_TEST(t1_bits);
+        CPPUNIT_TEST(t2_crc5);
+        CPPUNIT_TEST(t3_crc16);
+        CPPUNIT_TEST(t4_query);
+        CPPUNIT_TEST(t5_commands);
+        CPPUNIT_TEST(t6_repair);
+        CPPUNIT_TEST_SUITE_END();
+
+      private:
+        void t1_bits();
+        void t2_crc5();
+        void t3_crc16();
+        void t4_query();
+        void t5_commands();
+        void t6_repair();
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_QA_GEN2_CODEC_H */
@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "qa_latency_histogram.h"
+#include <rfid/latency_histogram.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    void qa_latency_histogram::t1_small()
+    {
+      // below LATENCY_SUB_BUCKETS every value has its own bucket
+      for(int v = 0; v < LATENCY_SUB_BUCKETS; v++)
+      {
+        CPPUNIT_ASSERT_EQUAL(v, latency_histogram::bucket(v));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)v, latency_histogram::bucket_low(v));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)v, latency_histogram::bucket_high(v));
+      }
+    }
+
+    void qa_latency_histogram::t2_powers_of_two()
+    {
+      // a power of two starts a bucket and the value before it ends the previous one
+      for(int k = LATENCY_SUB_BITS; k < LATENCY_MAX_BITS; k++)
+      {
+        uint64_t edge = 1ull << k;
+        int b = latency_histogram::bucket(edge);
+        CPPUNIT_ASSERT_EQUAL((k - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS, b);
+        CPPUNIT_ASSERT_EQUAL(edge, latency_histogram::bucket_low(b));
+        CPPUNIT_ASSERT_EQUAL(b - 1, latency_histogram::bucket(edge - 1));
+        CPPUNIT_ASSERT_EQUAL(edge - 1, latency_histogram::bucket_high(b - 1));
+        CPPUNIT_ASSERT_EQUAL(b, latency_histogram::bucket(edge + (edge >> LATENCY_SUB_BITS) - 1));
+        CPPUNIT_ASSERT_EQUAL(b + 1, latency_histogram::bucket(edge + (edge >> LATENCY_SUB_BITS)));
+      }
+
+      // values past 2^LATENCY_MAX_BITS are counted in the last bucket
+      uint64_t max_value = (1ull << LATENCY_MAX_BITS) - 1;
+      CPPUNIT_ASSERT_EQUAL(LATENCY_N_BUCKETS - 1, latency_histogram::bucket(max_value));
+      CPPUNIT_ASSERT_EQUAL(LATENCY_N_BUCKETS - 1, latency_histogram::bucket(max_value + 1));
+      CPPUNIT_ASSERT_EQUAL(LATENCY_N_BUCKETS - 1, latency_histogram::bucket(UINT64_MAX));
+      CPPUNIT_ASSERT_EQUAL(max_value, latency_histogram::bucket_high(LATENCY_N_BUCKETS - 1));
+    }
+
+    void qa_latency_histogram::t3_round_trip()
+    {
+      // the buckets tile the values without gaps, each within 1/16 of its values
+      for(int b = 0; b < LATENCY_N_BUCKETS; b++)
+      {
+        uint64_t low = latency_histogram::bucket_low(b);
+        uint64_t high = latency_histogram::bucket_high(b);
+        CPPUNIT_ASSERT(low <= high);
+        CPPUNIT_ASSERT_EQUAL(b, latency_histogram::bucket(low));
+        CPPUNIT_ASSERT_EQUAL(b, latency_histogram::bucket(high));
+        CPPUNIT_ASSERT((high - low) * LATENCY_SUB_BUCKETS <= low);
+        if(b + 1 < LATENCY_N_BUCKETS)
+          CPPUNIT_ASSERT_EQUAL(high + 1, latency_histogram::bucket_low(b + 1));
+      }
+    }
+
+    void qa_latency_histogram::t4_percentile()
+    {
+      latency_histogram hist;
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.percentile(50));
+
+      for(int v = 1; v <= 100; v++)
+        hist.record(v);
+
+      // the largest value of the bucket of the rank, capped at the maximum
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1, hist.percentile(0));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)51, hist.percentile(50));   // 50 is in [50, 51]
+      CPPUNIT_ASSERT_EQUAL((uint64_t)91, hist.percentile(90));   // 90 is in [88, 91]
+      CPPUNIT_ASSERT_EQUAL((uint64_t)99, hist.percentile(99));   // 99 is in [96, 99]
+      CPPUNIT_ASSERT_EQUAL((uint64_t)100, hist.percentile(100)); // 100 is in [100, 103]
+
+      // one outlier moves only the top percentile
+      latency_histogram tail;
+      for(int i = 0; i < 99; i++)
+        tail.record(1000);
+      tail.record(1000000);
+      uint64_t p50 = tail.percentile(50);
+      CPPUNIT_ASSERT(p50 >= 1000 && p50 < 1000 + 1000 / LATENCY_SUB_BUCKETS);
+      CPPUNIT_ASSERT_EQUAL(p50, tail.percentile(99));
+      CPPUNIT_ASSERT_EQUAL((uint64_t)1000000, tail.percentile(100));
+    }
+
+    void qa_latency_histogram::t5_record()
+    {
+      latency_histogram hist;
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.count());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.min());
+
+      hist.record(-5);  // counted as zero
+      hist.record(10);
+      hist.record(30);
+      CPPUNIT_ASSERT_EQUAL((uint64_t)3, hist.count());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.min());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)30, hist.max());
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(40.0 / 3, hist.mean(), 1e-9);
+
+      hist.reset();
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.count());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.max());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)0, hist.percentile(100));
+    }
+  }
+}
@@ -0,0 +1,52 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_QA_LATENCY_HISTOGRAM_H
+#define INCLUDED_RFID_QA_LATENCY_HISTOGRAM_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    class qa_latency_histogram : public CppUnit::TestCase
+    {
+      public:
+        CPPUNIT_TEST_SUITE(qa_latency_histogram);
+        CPPUNIT_TEST(t1_small);
+        CPPUNIT_TEST(t2_powers_of_two);
+        CPPUNIT_TEST(t3_round_trip);
+        CPPUNIT_TEST(t4_percentile);
+        CPPUNIT_TEST(t5_record);
+        CPPUNIT_TEST_SUITE_END();
+
+      private:
+        void t1_small();
+        void t2_powers_of_two();
+        void t3_round_trip();
+        void t4_percentile();
+        void t5_record();
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_QA_LATENCY_HISTOGRAM_H */
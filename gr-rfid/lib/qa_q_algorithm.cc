@@ -0,0 +1,191 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "qa_q_algorithm.h"
+#include <rfid/q_algorithm.h>
+#include "rfid/global_vars.h"
+
+namespace gr
+{
+  namespace rfid
+  {
+    // state of a chain in the middle of a round at Q, with the default run limits
+    static reader_context::sptr make_context(float q, float c)
+    {
+      reader_context::sptr context = reader_context::make();
+      READER_STATS & stats = context->state()->reader_stats;
+      stats.q.reset(q, c);
+      stats.max_slot_number = stats.q.n_slots();
+      return context;
+    }
+
+    void qa_q_algorithm::t1_update()
+    {
+      q_algorithm q;
+      q.reset(4, 0.3);
+      CPPUNIT_ASSERT_EQUAL(4, q.q());
+      CPPUNIT_ASSERT_EQUAL(16, q.n_slots());
+
+      // Qfp 3.7 still rounds to 4, 3.4 to 3
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_UNCHANGED, q.update(SLOT_EMPTY));
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_DECREMENT, q.update(SLOT_EMPTY));
+      CPPUNIT_ASSERT_EQUAL(3, q.q());
+
+      // a single slot leaves Qfp alone
+      for(int i = 0; i < 10; i++)
+        CPPUNIT_ASSERT_EQUAL(GEN2_Q_UNCHANGED, q.update(SLOT_SINGLE));
+
+      // 3.7 rounds to 4 again
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_INCREMENT, q.update(SLOT_COLLISION));
+      CPPUNIT_ASSERT_EQUAL(4, q.q());
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_UNCHANGED, q.update(SLOT_UNKNOWN));
+      CPPUNIT_ASSERT_EQUAL(4, q.q());
+    }
+
+    void qa_q_algorithm::t2_bounds()
+    {
+      // C is capped at 0.5, so Q moves by one per slot at most
+      q_algorithm q;
+      q.reset(20, 3);
+      CPPUNIT_ASSERT_EQUAL(GEN2_MAX_Q, q.q());
+
+      int prev = q.q();
+      for(int i = 0; i < 40; i++)
+      {
+        GEN2_Q_UPDN updn = q.update(SLOT_EMPTY);
+        CPPUNIT_ASSERT((prev - q.q() == 0) || (prev - q.q() == 1));
+        CPPUNIT_ASSERT_EQUAL(prev == q.q() ? GEN2_Q_UNCHANGED : GEN2_Q_DECREMENT, updn);
+        prev = q.q();
+      }
+      CPPUNIT_ASSERT_EQUAL(GEN2_MIN_Q, q.q());
+
+      for(int i = 0; i < 40; i++)
+        q.update(SLOT_COLLISION);
+      CPPUNIT_ASSERT_EQUAL(GEN2_MAX_Q, q.q());
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_UNCHANGED, q.update(SLOT_COLLISION));
+
+      q.reset(-2, 0.3);
+      CPPUNIT_ASSERT_EQUAL(GEN2_MIN_Q, q.q());
+      CPPUNIT_ASSERT_EQUAL(1, q.n_slots());
+    }
+
+    void qa_q_algorithm::t3_round()
+    {
+      reader_context::sptr context = make_context(2, 0.5);
+      READER_STATE * state = context->state();
+      READER_STATS & stats = state->reader_stats;
+
+      // single slots go on with a QueryRep until the 2^Q slots are done
+      for(int slot = 1; slot < 4; slot++)
+      {
+        CPPUNIT_ASSERT_EQUAL(slot, stats.cur_slot_number.load());
+        CPPUNIT_ASSERT(!end_slot(state, SLOT_SINGLE));
+        CPPUNIT_ASSERT_EQUAL(SEND_QUERY_REP, state->gen2_logic_status);
+      }
+
+      CPPUNIT_ASSERT(end_slot(state, SLOT_SINGLE));
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY, state->gen2_logic_status);
+      CPPUNIT_ASSERT_EQUAL(2, stats.cur_inventory_round.load());
+      CPPUNIT_ASSERT_EQUAL(1, stats.cur_slot_number.load());
+      CPPUNIT_ASSERT_EQUAL(4, stats.max_slot_number.load());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)4, stats.n_slots[SLOT_SINGLE].load());
+
+      // a Q change on the last slot of the round goes into the next Query
+      for(int slot = 1; slot < 4; slot++)
+        end_slot(state, SLOT_SINGLE);
+      CPPUNIT_ASSERT(end_slot(state, SLOT_COLLISION));
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY, state->gen2_logic_status);
+      CPPUNIT_ASSERT_EQUAL(3, stats.cur_inventory_round.load());
+      CPPUNIT_ASSERT_EQUAL(3, stats.q.q());
+      CPPUNIT_ASSERT_EQUAL(8, stats.max_slot_number.load());
+    }
+
+    void qa_q_algorithm::t4_query_adjust()
+    {
+      reader_context::sptr context = make_context(2, 0.5);
+      READER_STATE * state = context->state();
+      READER_STATS & stats = state->reader_stats;
+
+      end_slot(state, SLOT_SINGLE);
+      CPPUNIT_ASSERT_EQUAL(2, stats.cur_slot_number.load());
+
+      // Q goes up within the round, the tags draw from 2^Q slots again
+      CPPUNIT_ASSERT(!end_slot(state, SLOT_COLLISION));
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY_ADJUST, state->gen2_logic_status);
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_INCREMENT, stats.q_adjust);
+      CPPUNIT_ASSERT_EQUAL(1, stats.cur_slot_number.load());
+      CPPUNIT_ASSERT_EQUAL(8, stats.max_slot_number.load());
+      CPPUNIT_ASSERT_EQUAL(1, stats.cur_inventory_round.load());
+
+      // and back down
+      CPPUNIT_ASSERT(!end_slot(state, SLOT_EMPTY));
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY_ADJUST, state->gen2_logic_status);
+      CPPUNIT_ASSERT_EQUAL(GEN2_Q_DECREMENT, stats.q_adjust);
+      CPPUNIT_ASSERT_EQUAL(1, stats.cur_slot_number.load());
+      CPPUNIT_ASSERT_EQUAL(4, stats.max_slot_number.load());
+
+      CPPUNIT_ASSERT(!end_slot(state, SLOT_SINGLE));
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY_REP, state->gen2_logic_status);
+      CPPUNIT_ASSERT_EQUAL(2, stats.cur_slot_number.load());
+    }
+
+    void qa_q_algorithm::t5_unknown()
+    {
+      reader_context::sptr context = make_context(4, 0.5);
+      READER_STATE * state = context->state();
+      READER_STATS & stats = state->reader_stats;
+
+      // slots whose command was not seen are counted but leave Q alone
+      for(int i = 0; i < 10; i++)
+        end_slot(state, SLOT_UNKNOWN);
+      CPPUNIT_ASSERT_EQUAL(4, stats.q.q());
+      CPPUNIT_ASSERT_EQUAL((uint64_t)10, stats.n_slots[SLOT_UNKNOWN].load());
+      CPPUNIT_ASSERT_EQUAL(SEND_QUERY_REP, state->gen2_logic_status);
+
+      // empty slots bring Q down to 0 and keep it there
+      for(int i = 0; i < 40; i++)
+        end_slot(state, SLOT_EMPTY);
+      CPPUNIT_ASSERT_EQUAL(0, stats.q.q());
+      CPPUNIT_ASSERT_EQUAL(1, stats.max_slot_number.load());
+    }
+
+    void qa_q_algorithm::t6_run_limit()
+    {
+      reader_context::sptr context = make_context(2, 0.5);
+      READER_STATE * state = context->state();
+
+      state->run_limits.max_queries = 3;
+      state->reader_stats.n_queries_sent.add(2);
+      CPPUNIT_ASSERT(!end_slot(state, SLOT_SINGLE));
+      CPPUNIT_ASSERT_EQUAL(RUNNING, state->status.load());
+
+      // the inventory ends on the slot boundary after the limit
+      state->reader_stats.n_queries_sent.add();
+      CPPUNIT_ASSERT(end_slot(state, SLOT_SINGLE));
+      CPPUNIT_ASSERT_EQUAL(TERMINATED, state->status.load());
+      CPPUNIT_ASSERT_EQUAL(DECODER_TERMINATED, state->decoder_status);
+      CPPUNIT_ASSERT_EQUAL(2, state->reader_stats.cur_slot_number.load());
+    }
+  }
+}
@@ -0,0 +1,54 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_QA_Q_ALGORITHM_H
+#define INCLUDED_RFID_QA_Q_ALGORITHM_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    class qa_q_algorithm : public CppUnit::TestCase
+    {
+      public:
+        CPPUNIT_TEST_SUITE(qa_q_algorithm);
+        CPPUNIT_TEST(t1_update);
+        CPPUNIT_TEST(t2_bounds);
+        CPPUNIT_TEST(t3_round);
+        CPPUNIT_TEST(t4_query_adjust);
+        CPPUNIT_TEST(t5_unknown);
+        CPPUNIT_TEST(t6_run_limit);
+        CPPUNIT_TEST_SUITE_END();
+
+      private:
+        void t1_update();
+        void t2_bounds();
+        void t3_round();
+        void t4_query_adjust();
+        void t5_unknown();
+        void t6_run_limit();
+    };
+  }
+}
+
+#endif /* INCLUDED_RFID_QA_Q_ALGORITHM_H */
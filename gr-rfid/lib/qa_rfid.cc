@@ -26,11 +26,19 @@
  */
 
 #include "qa_rfid.h"
+#include "qa_gen2_codec.h"
+#include "qa_epc_table.h"
+#include "qa_q_algorithm.h"
+#include "qa_latency_histogram.h"
 
 CppUnit::TestSuite *
 qa_rfid::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("rfid");
+  s->addTest(gr::rfid::qa_gen2_codec::suite());
+  s->addTest(gr::rfid::qa_epc_table::suite());
+  s->addTest(gr::rfid::qa_q_algorithm::suite());
+  s->addTest(gr::rfid::qa_latency_histogram::suite());
 
   return s;
 }
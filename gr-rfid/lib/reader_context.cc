@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <rfid/reader_context.h>
+#include "rfid/global_vars.h"
+#include <new>
+#include <stdlib.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // the stat_counters of READER_STATE are cache line aligned, which new
+    // does not honour for over-aligned types before C++17
+    static READER_STATE * new_reader_state(void)
+    {
+      void * p;
+      if(posix_memalign(&p, alignof(READER_STATE), sizeof(READER_STATE)) != 0)
+        throw std::bad_alloc();
+      return new(p) READER_STATE;
+    }
+
+    reader_context::sptr reader_context::make(const std::string & name)
+    {
+      return sptr(new reader_context(name));
+    }
+
+    reader_context::reader_context(const std::string & name)
+      : context_name(name), reader_state(new_reader_state())
+    {
+      initialize_reader_state(reader_state);
+    }
+
+    reader_context::~reader_context()
+    {
+      reader_state->~READER_STATE();
+      free(reader_state);
+    }
+
+    std::string reader_context::file_path(const std::string & base) const
+    {
+      if(context_name.empty()) return base;
+
+      // the name goes in front of the extension, stats.prom becomes stats_name.prom
+      size_t dot = base.rfind('.');
+      size_t slash = base.rfind('/');
+      if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) return base + "_" + context_name;
+      return base.substr(0, dot) + "_" + context_name + base.substr(dot);
+    }
+  }
+}
@@ -26,40 +26,51 @@
 #include "reader_impl.h"
 #include "rfid/global_vars.h"
 #include <sys/time.h>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
 
 namespace gr
 {
   namespace rfid
   {
     reader::sptr
-    reader::make(int sample_rate, int dac_rate)
+    reader::make(reader_context::sptr context, int sample_rate, int dac_rate, const link_profile & profile)
     {
       return gnuradio::get_initial_sptr
-      (new reader_impl(sample_rate,dac_rate));
+      (new reader_impl(context,sample_rate,dac_rate,profile));
     }
 
     /*
     * The private constructor
     */
-    reader_impl::reader_impl(int sample_rate, int dac_rate)
+    reader_impl::reader_impl(reader_context::sptr context, int sample_rate, int dac_rate, const link_profile & profile)
     : gr::block("reader",
-      gr::io_signature::make( 1, 1, sizeof(float)),
-      gr::io_signature::make( 1, 1, sizeof(float)))
+      gr::io_signature::make( 0, 0, 0),
+      gr::io_signature::make( 1, 1, sizeof(float))),
+      context(context), reader_state(context->state()),
+      profile(profile),
+      exporter(context->state(), context->file_path(stats_file_path), context->name(), STATS_EXPORT_PERIOD_MS),
+      log(context->file_path(log_file_path))
     {
+      // the RN16s come from the tag_decoder as messages
+      message_port_register_in(rn16_port());
+      set_msg_handler(rn16_port(), boost::bind(&reader_impl::handle_rn16, this, _1));
+
       sample_d = 1.0/dac_rate * pow(10,6);
 
       // Number of samples for transmitting
-      n_data0_s = 2 * PW_D / sample_d;
-      n_data1_s = 4 * PW_D / sample_d;
-      n_pw_s    = PW_D    / sample_d;
-      n_cw_s    = CW_D    / sample_d;
-      n_delim_s = DELIM_D / sample_d;
-      n_trcal_s = TRCAL_D / sample_d;
+      n_data0_s = 2 * profile.pw / sample_d;
+      n_data1_s = 4 * profile.pw / sample_d;
+      n_pw_s    = profile.pw    / sample_d;
+      n_cw_s    = profile.cw    / sample_d;
+      n_delim_s = profile.delim / sample_d;
+      n_trcal_s = profile.trcal / sample_d;
 
       // CW waveforms of different sizes
-      n_cwquery_s   = (T1_D+T2_D+RN16_D)/sample_d;     //RN16
-      n_cwack_s     = (T1_D+T2_D+EPC_D)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag
-      n_p_down_s     = (P_DOWN_D)/sample_d;
+      n_cwquery_s   = (profile.t1+profile.t2+profile.rn16)/sample_d;     //RN16
+      n_cwack_s     = (profile.t1+profile.t2+profile.epc)/sample_d;    //EPC   if it is longer than nominal it wont cause tags to change inventoried flag
+      n_p_down_s     = (profile.p_down)/sample_d;
 
       p_down.resize(n_p_down_s);        // Power down samples
       cw_query.resize(n_cwquery_s);      // Sent after query/query rep
@@ -94,325 +105,422 @@ namespace gr
       frame_sync.insert( frame_sync.end(), data_0.begin(), data_0.end() );
       frame_sync.insert( frame_sync.end(), rtcal.begin() , rtcal.end() );
 
+      gen2_bits bits;
+
       // create query rep
       query_rep.insert( query_rep.end(), frame_sync.begin(), frame_sync.end());
-      query_rep.insert( query_rep.end(), data_0.begin(), data_0.end() );
-      query_rep.insert( query_rep.end(), data_0.begin(), data_0.end() );
-      query_rep.insert( query_rep.end(), data_0.begin(), data_0.end() );
-      query_rep.insert( query_rep.end(), data_0.begin(), data_0.end() );
+      gen2_encode_query_rep((SESSION[0] << 1) | SESSION[1], &query_rep_bits);
+      append_waveform(query_rep, query_rep_bits);
 
       // create nak
       nak.insert( nak.end(), frame_sync.begin(), frame_sync.end());
-      nak.insert( nak.end(), data_1.begin(), data_1.end() );
-      nak.insert( nak.end(), data_1.begin(), data_1.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
-      nak.insert( nak.end(), data_0.begin(), data_0.end() );
+      gen2_encode_nak(&bits);
+      append_waveform(nak, bits);
+
+      // render the constant commands
+      start_command = cw_ack;
+      query_rep_command.insert( query_rep_command.end(), cw.begin(), cw.end() );
+      query_rep_command.insert( query_rep_command.end(), query_rep.begin(), query_rep.end() );
+      query_rep_command.insert( query_rep_command.end(), cw_query.begin(), cw_query.end() );
+
+      // bits of the Query and ACK commands, a bit is at most data_1 long
+      query_command.resize(GEN2_QUERY_BITS * data_1.size());
+      ack_command.resize(GEN2_ACK_BITS * data_1.size());
+
+      // an ACK can be queued behind the Query of its slot, each is at most CW, sync, bits and CW
+      segments.reserve(8);
+      segment_index = 0;
+      segment_offset = 0;
+      ack_segment = -1;
 
       gen_query_bits();
       gen_query_adjust_bits();
     }
 
-    void reader_impl::gen_query_bits()
+    void reader_impl::queue(const float * samples, int length)
     {
-      int num_ones = 0, num_zeros = 0;
+      waveform_segment segment = {samples, length};
+      segments.push_back(segment);
+    }
 
-      query_bits.resize(0);
-      query_bits.insert(query_bits.end(), &QUERY_CODE[0], &QUERY_CODE[4]);
-/*
-      query_bits.push_back(DR);
-      query_bits.insert(query_bits.end(), &M[0], &M[2]);
-      query_bits.push_back(TREXT);
-      query_bits.insert(query_bits.end(), &SEL[0], &SEL[2]);
-      query_bits.insert(query_bits.end(), &SESSION[0], &SESSION[2]);
-      query_bits.push_back(TARGET);
-
-      query_bits.insert(query_bits.end(), &Q_VALUE[FIXED_Q][0], &Q_VALUE[FIXED_Q][4]);
-      */
-
-      //insert round number instead of normal query bits
-      std::vector<float> tmp_round;
-      tmp_round.resize(0);
-
-      int round = reader_state->reader_stats.cur_inventory_round;
-      for(int i = 0; i< 12; i++){
-        if((round & 0x1) == 1){
-          tmp_round.push_back(1);
-        }else{
-          tmp_round.push_back(0);
+    void reader_impl::queue(const std::vector<float> & waveform)
+    {
+      queue(&waveform[0], waveform.size());
+    }
+
+    void reader_impl::queue_command(const std::vector<float> & sync, const gen2_bits & bits, const std::vector<float> & cw_after, std::vector<float> & buffer)
+    {
+      float * dst = &buffer[0];
+      for(int i=0 ; i<bits.size() ; i++)
+      {
+        const std::vector<float> & symbol = bits[i] ? data_1 : data_0;
+        memcpy(dst, &symbol[0], sizeof(float) * symbol.size());
+        dst += symbol.size();
+      }
+      reader_state-> sent_bit = bits;
+
+      queue(cw);
+      queue(sync);
+      queue(&buffer[0], dst - &buffer[0]);
+      queue(cw_after);
+    }
+
+    int reader_impl::emit(float * out, int noutput_items)
+    {
+      int written = 0;
+      while(emitting() && written < noutput_items)
+      {
+        const waveform_segment & segment = segments[segment_index];
+        int n = std::min(segment.length - segment_offset, noutput_items - written);
+
+        // the first sample of the ACK leaves the block
+        if(segment_index == ack_segment && segment_offset == 0)
+        {
+          int64_t now = latency_clock_ns();
+          reader_state->reader_stats.latency[LAT_ACK_QUEUED_TO_SENT].record(now - ack_queued_time);
+          reader_state->reader_stats.latency[LAT_GATE_TO_ACK_SENT].record(now - ack_open_time);
+          ack_segment = -1;
+        }
+
+        memcpy(&out[written], segment.samples + segment_offset, sizeof(float) * n);
+        written += n;
+        segment_offset += n;
+
+        if(segment_offset == segment.length)
+        {
+          segment_index++;
+          segment_offset = 0;
         }
-        round = round >> 1;
       }
 
-      for(int i = 0; i< 12; i++){
-        query_bits.push_back(tmp_round.back());
-        tmp_round.pop_back();
+      if(!emitting())
+      {
+        segments.clear();
+        segment_index = 0;
       }
-      query_bits.push_back(0);
+      return written;
+    }
 
+    void reader_impl::append_waveform(std::vector<float> & waveform, const gen2_bits & bits)
+    {
+      for(int i=0 ; i<bits.size() ; i++)
+      {
+        if(bits[i]) waveform.insert(waveform.end(), data_1.begin(), data_1.end());
+        else waveform.insert(waveform.end(), data_0.begin(), data_0.end());
+      }
+    }
+
+    void reader_impl::gen_query_bits()
+    {
+      if(ADAPTIVE_Q)
+      {
+        gen2_query query = {profile.dr_bit(), (M[0] << 1) | M[1], TREXT, (SEL[0] << 1) | SEL[1], (SESSION[0] << 1) | SESSION[1], TARGET, reader_state->reader_stats.q.q()};
+        gen2_encode_query(query, &query_bits);
+        return;
+      }
 
-      crc_append(query_bits);
+      // with a fixed Q the round number is sent in place of the
+      // DR/M/TRext/Sel/Session/Target/Q fields
+      query_bits.clear();
+      query_bits.push(GEN2_QUERY_CODE, 4);
+      query_bits.push(reader_state->reader_stats.cur_inventory_round, 12);
+      query_bits.push(0);
+
+      gen2_append_crc5(&query_bits);
     }
 
-    void reader_impl::gen_ack_bits(const float * in)
+    void reader_impl::gen_ack_bits(uint16_t rn16)
     {
-      ack_bits.resize(0);
-      ack_bits.insert(ack_bits.end(), &ACK_CODE[0], &ACK_CODE[2]);
-      ack_bits.insert(ack_bits.end(), &in[0], &in[16]);
+      gen2_encode_ack(rn16, &ack_bits);
     }
 
     void reader_impl::gen_query_adjust_bits()
     {
-      query_adjust_bits.resize(0);
-      query_adjust_bits.insert(query_adjust_bits.end(), &QADJ_CODE[0], &QADJ_CODE[4]);
-      query_adjust_bits.insert(query_adjust_bits.end(), &SESSION[0], &SESSION[2]);
-      query_adjust_bits.insert(query_adjust_bits.end(), &Q_UPDN[1][0], &Q_UPDN[1][3]);
+      gen2_encode_query_adjust((SESSION[0] << 1) | SESSION[1], reader_state->reader_stats.q_adjust, &query_adjust_bits);
     }
 
-    reader_impl::~reader_impl(){}
+    reader_impl::~reader_impl()
+    {
+      // the exporter thread reads the reader state
+      exporter.stop();
+    }
 
-    void reader_impl::forecast(int noutput_items, gr_vector_int &ninput_items_required)
+    bool reader_impl::start()
     {
-      ninput_items_required[0] = 0;
+      if(STATS_EXPORT) exporter.start();
+      return block::start();
     }
 
-    void reader_impl::transmit(float* out, int* written, std::vector<float> bits)
+    void reader_impl::set_run_limits(double duration, int unique_tags, int queries)
     {
-      memcpy(&out[*written], &bits[0], sizeof(float) * bits.size());
-      (*written) += bits.size();
+      reader_state->run_limits.max_duration_ms = (long)(duration * 1000);
+      reader_state->run_limits.max_unique_tags = unique_tags;
+      reader_state->run_limits.max_queries     = queries;
     }
 
-    void reader_impl::transmit_bits(float* out, int* written, std::vector<float> bits)
+    bool reader_impl::stop()
     {
-      reader_state-> sent_bit.resize(bits.size());
-      for(int i=0 ; i<bits.size() ; i++)
+      // the last snapshot holds the final counts
+      exporter.stop();
+      wake_reader(reader_state);
+      if(STATS_EXPORT) exporter.export_now();
+      return block::stop();
+    }
+
+    void reader_impl::handle_rn16(pmt::pmt_t msg)
+    {
+      rn16_result result;
+      if(!rn16_result_from_pmt(msg, &result)) return;
+
+      // the RN16 of a slot the reader has already left is not acknowledged. The
+      // tag_decoder leaves the slot open after it posts an RN16, so it is ended
+      // here and the inventory goes on with the next command
+      if(result.round != reader_state->reader_stats.cur_inventory_round || result.slot != reader_state->reader_stats.cur_slot_number)
       {
-        reader_state-> sent_bit[i] = bits[i];
-        if(bits[i] == 1) transmit(out, written, data_1);
-        else transmit(out, written, data_0);
+        log.file("│ Stale RN16 of %d_%d, end the slot\n", result.round, result.slot);
+        log.file("├──────────────────────────────────────────────────\n");
+        log.console("Stale RN16 | ");
+        end_slot(reader_state, SLOT_UNKNOWN);
+        return;
       }
+
+      reader_state->reader_stats.n_ack_sent.add();
+
+      // Controls the other two blocks
+      reader_state->decoder_status = DECODER_DECODE_EPC;
+      reader_state->gate_status    = GATE_SEEK_EPC;
+      reader_state->reader_sent_status = FRAME_SYNC;
+
+      // queued behind the CW of the Query, it is sent as soon as that ends
+      gen_ack_bits(result.rn16);
+      ack_segment = segments.size() + 1;  // after the CW in front of the frame sync
+      queue_command(frame_sync, ack_bits, cw_ack, ack_command);
+
+      ack_open_time = result.open_time;
+      ack_queued_time = latency_clock_ns();
+      reader_state->reader_stats.latency[LAT_RN16_TO_ACK_QUEUED].record(ack_queued_time - result.decode_time);
+
+      reader_state->reader_stats.ack_sent.push(result.round, result.slot, result.rn16);
+      log.file("│ Send ACK\n");
+      log.file("├──────────────────────────────────────────────────\n");
+      log.console("ACK | ");
     }
 
     int reader_impl::general_work(int noutput_items, gr_vector_int &ninput_items, gr_vector_const_void_star &input_items, gr_vector_void_star &output_items)
     {
-      const float* in = (const float*)input_items[0];
       float* out = (float*)output_items[0];
-      int consumed = 0;
-      int written = 0;
+
+      // read before the state, so a change while the commands are queued is not missed
+      uint64_t n_wakes = wakes();
 
       float tp[2]={1,0};
 
-      if(reader_state->gen2_logic_status != IDLE)
-      {
-        log.open(log_file_path, std::ios::app);
+      // the flowgraph finishes after the last command of the inventory
+      if(reader_state->status == TERMINATED && !emitting()) return WORK_DONE;
 
+      // the next command is queued once the previous one is sent
+      if(!emitting() && reader_state->gen2_logic_status != IDLE)
+      {
         if(reader_state->gen2_logic_status == START)
         {
-          log << "preamble= " << n_delim_s + n_data0_s + n_data0_s + n_data1_s + n_trcal_s << std::endl;
-          log << "frame_sync= " << n_delim_s + n_data0_s + n_data0_s + n_data1_s << std::endl;
-          log << "delim= " << n_delim_s << std::endl;
-          log << "data_0= " << n_data0_s << std::endl;
-          log << "rtcal= " << n_data0_s + n_data1_s << std::endl;
-          log << "trcal= " << n_trcal_s << std::endl << std::endl;
-
-          log << "cw_query= " << n_cwquery_s << std::endl;
-          log << "cw_ack= " << n_cwack_s << std::endl;
-          log << "T1= " << T1_D / sample_d << std::endl;
-          log << "T2= " << T2_D / sample_d << std::endl;
-          log << "RN16= " << RN16_D / sample_d << std::endl;
-          log << "EPC= " << EPC_D / sample_d << std::endl << std::endl;
-
-          transmit(out, &written, cw_ack);
-          reader_state->gen2_logic_status = IDLE;
+          log.file("BLF= %d | PW= %g | DR= %g\n", profile.blf, profile.pw, profile.dr);
+          log.file("preamble= %g\n", n_delim_s + n_data0_s + n_data0_s + n_data1_s + n_trcal_s);
+          log.file("frame_sync= %g\n", n_delim_s + n_data0_s + n_data0_s + n_data1_s);
+          log.file("delim= %g\n", n_delim_s);
+          log.file("data_0= %g\n", n_data0_s);
+          log.file("rtcal= %g\n", n_data0_s + n_data1_s);
+          log.file("trcal= %g\n\n", n_trcal_s);
+
+          log.file("cw_query= %d\n", n_cwquery_s);
+          log.file("cw_ack= %d\n", n_cwack_s);
+          log.file("T1= %g\n", profile.t1 / sample_d);
+          log.file("T2= %g\n", profile.t2 / sample_d);
+          log.file("RN16= %g\n", profile.rn16 / sample_d);
+          log.file("EPC= %g\n\n", profile.epc / sample_d);
+
+          // the CW powers up the tags, the first Query follows it
+          queue(start_command);
+          reader_state->gen2_logic_status = SEND_QUERY;
+
+          // the run time and the duration limit count from the first command
+          gettimeofday(&reader_state->reader_stats.start, NULL);
         }
         else if(reader_state->gen2_logic_status == SEND_QUERY)
         {
           reader_state->gen2_logic_status = IDLE;
 
-          log << std::endl << "┌──────────────────────────────────────────────────" << std::endl;
-          log << "│ Inventory Round: " << reader_state->reader_stats.cur_inventory_round << " | Slot Number: " << reader_state->reader_stats.cur_slot_number << std::endl;
-          std::cout << std::endl << "[" << reader_state->reader_stats.cur_inventory_round << "_" << reader_state->reader_stats.cur_slot_number << "] ";
-          reader_state->reader_stats.n_queries_sent +=1;
+          log.file("\n┌──────────────────────────────────────────────────\n");
+          log.file("│ Inventory Round: %d | Slot Number: %d\n", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          log.console("\n[%d_%d] ", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          reader_state->reader_stats.n_queries_sent.add();
 
           // Controls the other two blocks
           reader_state->decoder_status = DECODER_DECODE_RN16;
           reader_state->gate_status    = GATE_SEEK_RN16;
           reader_state->reader_sent_status = PREAMBLE;
 
-          transmit(out, &written, cw);
-          transmit(out, &written, preamble);
           gen_query_bits();
-          transmit_bits(out, &written, query_bits);
+          queue_command(preamble, query_bits, cw_query, query_command);
 
-
-          transmit(out, &written, cw_query);
-
-          log << "│ Send Query | Q= " << FIXED_Q << std::endl;
-          log << "├──────────────────────────────────────────────────" << std::endl;
-          std::cout << "Query(Q=" << FIXED_Q << ") | ";
+          log.file("│ Send Query | Q= %d\n", reader_state->reader_stats.q.q());
+          log.file("├──────────────────────────────────────────────────\n");
+          log.console("Query(Q=%d) | ", reader_state->reader_stats.q.q());
         }
         else if(reader_state->gen2_logic_status == SEND_QUERY_REP)
         {
-          log << "│ Inventory Round: " << reader_state->reader_stats.cur_inventory_round << " | Slot Number: " << reader_state->reader_stats.cur_slot_number << std::endl;
-          std::cout << std::endl << "[" << reader_state->reader_stats.cur_inventory_round << "_" << reader_state->reader_stats.cur_slot_number << "] ";
-          reader_state->reader_stats.n_queries_sent +=1;
+          log.file("│ Inventory Round: %d | Slot Number: %d\n", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          log.console("\n[%d_%d] ", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          reader_state->reader_stats.n_queries_sent.add();
 
           // Controls the other two blocks
           reader_state->decoder_status = DECODER_DECODE_RN16;
           reader_state->gate_status    = GATE_SEEK_RN16;
           reader_state->reader_sent_status = FRAME_SYNC;
 
-          transmit(out, &written, cw);
-          transmit(out, &written, query_rep);
-          transmit(out, &written, cw_query);
-          log << "│ Send QueryRep" << std::endl;
-          log << "├──────────────────────────────────────────────────" << std::endl;
-          std::cout << "QueryRep | ";
+          queue(query_rep_command);
+          reader_state-> sent_bit = query_rep_bits;
+          log.file("│ Send QueryRep\n");
+          log.file("├──────────────────────────────────────────────────\n");
+          log.console("QueryRep | ");
 
 
           reader_state->gen2_logic_status = IDLE;
         }
-        else if(reader_state->gen2_logic_status == SEND_ACK && ninput_items[0] == RN16_BITS - 1)
+        else if(reader_state->gen2_logic_status == SEND_QUERY_ADJUST)
         {
-          reader_state->reader_stats.n_ack_sent +=1;
+          log.file("│ Inventory Round: %d | Slot Number: %d\n", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          log.console("\n[%d_%d] ", reader_state->reader_stats.cur_inventory_round.load(), reader_state->reader_stats.cur_slot_number.load());
+          reader_state->reader_stats.n_queries_sent.add();
 
           // Controls the other two blocks
-          reader_state->decoder_status = DECODER_DECODE_EPC;
-          reader_state->gate_status    = GATE_SEEK_EPC;
+          reader_state->decoder_status = DECODER_DECODE_RN16;
+          reader_state->gate_status    = GATE_SEEK_RN16;
           reader_state->reader_sent_status = FRAME_SYNC;
 
-          transmit(out, &written, cw);
-          transmit(out, &written, frame_sync);
-          gen_ack_bits(in);
-          transmit_bits(out, &written, ack_bits);
-          transmit(out, &written, cw_ack);
-
-          reader_state->reader_stats.ack_sent.push_back((std::to_string(reader_state->reader_stats.cur_inventory_round)+"_"+std::to_string(reader_state->reader_stats.cur_slot_number)).c_str());
-          log << "│ Send ACK" << std::endl;
-          log << "├──────────────────────────────────────────────────" << std::endl;
-          std::cout << "ACK | ";
+          gen_query_adjust_bits();
+          queue_command(frame_sync, query_adjust_bits, cw_query, query_command);
+          log.file("│ Send QueryAdjust | Q= %d\n", reader_state->reader_stats.q.q());
+          log.file("├──────────────────────────────────────────────────\n");
+          log.console("QueryAdjust(Q=%d) | ", reader_state->reader_stats.q.q());
 
-          consumed = ninput_items[0];
           reader_state->gen2_logic_status = IDLE;
         }
-        log.close();
       }
 
-      consume_each (consumed);
+      // GNU Radio calls a source again as soon as it returns 0, so the
+      // reader sleeps until end_slot or an RN16 gives it something to send
+      int written = emit(out, noutput_items);
+      if(written == 0) wait_idle(n_wakes);
       return written;
     }
 
-    int reader_impl::calc_usec(const struct timeval start, const struct timeval end)
+    uint64_t reader_impl::wakes(void)
     {
-      int sec = end.tv_sec - start.tv_sec;
-      int usec = sec * 1e6;
+      std::lock_guard<std::mutex> lock(reader_state->wake_mutex);
+      return reader_state->n_wakes;
+    }
+
+    void reader_impl::wait_idle(uint64_t n_wakes)
+    {
+      // bounded, the RN16 messages are handled between two calls of general_work
+      std::unique_lock<std::mutex> lock(reader_state->wake_mutex);
+      reader_state->wake.wait_for(lock, std::chrono::milliseconds(READER_IDLE_WAIT_MS), [this, n_wakes] { return reader_state->n_wakes != n_wakes; });
+    }
+
+    long reader_impl::calc_usec(const struct timeval start, const struct timeval end)
+    {
+      long sec = end.tv_sec - start.tv_sec;
+      long usec = sec * 1000000L;
       return usec + end.tv_usec - start.tv_usec;
     }
 
     void reader_impl::print_results()
     {
-      std::ofstream result(result_file_path, std::ios::out);
+      std::ofstream result(context->file_path(result_file_path).c_str(), std::ios::out);
 
       result << std::endl << "┌──────────────────────────────────────────────────" << std::endl;
-      result << "│ Number of QUERY/QUERYREP sent: " << reader_state->reader_stats.n_queries_sent << std::endl;
-      result << "│ Number of ACK sent: " << reader_state->reader_stats.n_ack_sent << std::endl;
+      result << "│ Number of QUERY/QUERYREP sent: " << reader_state->reader_stats.n_queries_sent.load() << std::endl;
+      result << "│ Number of ACK sent: " << reader_state->reader_stats.n_ack_sent.load() << std::endl;
+      result << "│ Slots empty/single/collided/unknown: " << reader_state->reader_stats.n_slots[SLOT_EMPTY].load() << "/" << reader_state->reader_stats.n_slots[SLOT_SINGLE].load() << "/" << reader_state->reader_stats.n_slots[SLOT_COLLISION].load() << "/" << reader_state->reader_stats.n_slots[SLOT_UNKNOWN].load() << " | Final Q: " << reader_state->reader_stats.q.q() << std::endl;
+      result << "│ Replies gate fail/preamble fail/RN16/CRC fail/EPC: ";
+      for(int i=0 ; i<N_SLOT_RESULTS ; i++)
+        result << (i ? "/" : "") << reader_state->reader_stats.n_results[i].load();
+      result << std::endl;
       result << "│ ";
-      for(int i=0 ; i<reader_state->reader_stats.ack_sent.size() ; i++)
-        result << reader_state->reader_stats.ack_sent[i] << " ";
+      const ACK_HISTORY & acks = reader_state->reader_stats.ack_sent;
+      for(int i=0 ; i<acks.size() ; i++)
+        result << acks[i].round << "_" << acks[i].slot << " ";
       result << std::endl << "│ Current Inventory round: " << reader_state->reader_stats.cur_inventory_round << std::endl;
       result << "├──────────────────────────────────────────────────" << std::endl;
-      result << "│ Number of correctly decoded EPC: " << reader_state->reader_stats.n_epc_correct << std::endl;
-      result << "│ Number of unique tags: " << reader_state->reader_stats.tag_reads.size() << std::endl;
+      result << "│ Number of correctly decoded EPC: " << reader_state->reader_stats.n_results[RESULT_EPC_OK].load() << std::endl;
+      result << "│ Number of EPC repaired by bit flipping: " << reader_state->reader_stats.n_epc_repaired.load() << std::endl;
+      result << "│ Number of unique tags: " << reader_state->reader_stats.tag_reads.confirmed() << " (" << reader_state->reader_stats.tag_reads.size() - reader_state->reader_stats.tag_reads.confirmed() << " more only read by repair)" << std::endl;
+      result << "│ Tag table dropped/evicted: " << reader_state->reader_stats.tag_reads.dropped() << "/" << reader_state->reader_stats.tag_reads.evicted() << std::endl;
 
-      if(reader_state->reader_stats.tag_reads.size())
+      std::vector<const epc_entry *> tags = reader_state->reader_stats.tag_reads.sorted();
+      if(tags.size())
       {
-        result << "├───────────────┬──────────────────────────────────" << std::endl;
-        result << "│ Tag ID\t│ Num of reads" << std::endl;
-        result << "├───────────────┼──────────────────────────────────" << std::endl;
+        result << "├──────┬──────────────────────────┬───────────────────────────────────────────────" << std::endl;
+        result << "│ PC\t│ EPC\t\t\t   │ Num of reads\tRepaired\tFirst seen\tLast seen\tCorr\tPhase" << std::endl;
+        result << "├──────┼──────────────────────────┼───────────────────────────────────────────────" << std::endl;
       }
 
-      std::map<int,int>::iterator it;
-      for(it = reader_state->reader_stats.tag_reads.begin(); it != reader_state->reader_stats.tag_reads.end(); it++)
-        result << "│ " << it->first << "\t\t" << "│ " << it->second << std::endl;
+      for(int i=0 ; i<tags.size() ; i++)
+      {
+        result << "│ " << std::hex << std::setfill('0') << std::setw(4) << tags[i]->pc() << " │ ";
+        for(int j=2 ; j<EPC_KEY_BYTES ; j++)
+          result << std::setw(2) << (int)tags[i]->key[j];
+        result << std::dec << std::setfill(' ') << " │ " << tags[i]->n_reads << "\t\t" << tags[i]->n_repaired << "\t\t" << tags[i]->first_seen << "\t" << tags[i]->last_seen;
+        result << "\t" << tags[i]->mean_corr() << "\t" << tags[i]->mean_phase() << std::endl;
+      }
 
-      if(reader_state->reader_stats.tag_reads.size())
-        result << "├───────────────┴──────────────────────────────────" << std::endl;
+      if(tags.size())
+        result << "├──────┴──────────────────────────┴───────────────────────────────────────────────" << std::endl;
       else
         result << "├──────────────────────────────────────────────────" << std::endl;
 
       gettimeofday (&reader_state-> reader_stats.end, NULL);
-      int execution_time = calc_usec(reader_state->reader_stats.start, reader_state->reader_stats.end);
+      long execution_time = calc_usec(reader_state->reader_stats.start, reader_state->reader_stats.end);
       result << "│ Execution time: " << execution_time << " (μs)" << std::endl;
-      result << "│ Throughput(EPC): " << (double)reader_state->reader_stats.n_epc_correct * (EPC_BITS - 1) / execution_time * 1e6 << " (bits/second)" << std::endl;
+      result << "│ Throughput(EPC): " << (double)reader_state->reader_stats.n_results[RESULT_EPC_OK].load() * (EPC_BITS - 1) / execution_time * 1e6 << " (bits/second)" << std::endl;
+      result << "├──────────────────────────────────────────────────" << std::endl;
+      print_latency_summary(result);
       result << "└──────────────────────────────────────────────────" << std::endl;
 
       result.close();
     }
+  
+    static const char * LATENCY_NAMES[N_LATENCIES] =
+    {
+      "Tag T1", "Gate open to preamble", "Preamble to RN16", "RN16 to ACK queued", "ACK queued to sent", "Gate open to ACK sent"
+    };
+
+    void reader_impl::print_latency_summary(std::ostream & out)
+    {
+      out << "│ Latency (μs)" << std::endl;
+      for(int i=0 ; i<N_LATENCIES ; i++)
+      {
+        out << "│ " << std::left << std::setw(24) << LATENCY_NAMES[i] << std::right;
+        reader_state->reader_stats.latency[i].print_summary(out, 1e3);
+        out << std::endl;
+      }
+    }
 
-    /* Function adapted from https://www.cgran.org/wiki/Gen2 */
-    void reader_impl::crc_append(std::vector<float> & q)
+    void reader_impl::print_latency()
     {
-      int crc[] = {1,0,0,1,0};
+      std::ofstream latency(context->file_path(latency_file_path).c_str(), std::ios::out);
 
-      for(int i = 0; i < 17; i++)
+      latency << "┌──────────────────────────────────────────────────" << std::endl;
+      print_latency_summary(latency);
+      for(int i=0 ; i<N_LATENCIES ; i++)
       {
-        int tmp[] = {0,0,0,0,0};
-        tmp[4] = crc[3];
-        if(crc[4] == 1)
-        {
-          if (q[i] == 1)
-          {
-            tmp[0] = 0;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            tmp[3] = crc[2];
-          }
-          else
-          {
-            tmp[0] = 1;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            if(crc[2] == 1)
-            {
-              tmp[3] = 0;
-            }
-            else
-            {
-              tmp[3] = 1;
-            }
-          }
-        }
-        else
-        {
-          if (q[i] == 1)
-          {
-            tmp[0] = 1;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            if(crc[2] == 1)
-            {
-              tmp[3] = 0;
-            }
-            else
-            {
-              tmp[3] = 1;
-            }
-          }
-          else
-          {
-            tmp[0] = 0;
-            tmp[1] = crc[0];
-            tmp[2] = crc[1];
-            tmp[3] = crc[2];
-          }
-        }
-        memcpy(crc, tmp, 5*sizeof(float));
+        latency << "├──────────────────────────────────────────────────" << std::endl;
+        latency << "│ " << LATENCY_NAMES[i] << " (from μs, to μs, count, cumulative)" << std::endl;
+        reader_state->reader_stats.latency[i].print_buckets(latency, 1e3);
       }
-      for (int i = 4; i >= 0; i--)
-        q.push_back(crc[i]);
+      latency << "└──────────────────────────────────────────────────" << std::endl;
+
+      latency.close();
     }
   }
 }
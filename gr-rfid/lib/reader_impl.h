@@ -22,6 +22,10 @@
 #define INCLUDED_RFID_READER_IMPL_H
 
 #include <rfid/reader.h>
+#include <rfid/gen2_codec.h>
+#include "logger.h"
+#include "rn16_message.h"
+#include "stats_exporter.h"
 #include <vector>
 #include <queue>
 #include <fstream>
@@ -33,27 +37,67 @@ namespace gr
     class reader_impl : public reader
     {
       private:
+        reader_context::sptr context;
+        READER_STATE * reader_state;  // state of the chain, owned by the context
+
+        link_profile profile;
         int s_rate, d_rate,  n_cwquery_s,  n_cwack_s,n_p_down_s;
         float sample_d, n_data0_s, n_data1_s, n_cw_s, n_pw_s, n_delim_s, n_trcal_s;
-        std::vector<float> data_0, data_1, cw, cw_ack, cw_query, delim, frame_sync, preamble, rtcal, trcal, query_bits, ack_bits, query_rep,nak, query_adjust_bits,p_down;
-        int q_change; // 0-> increment, 1-> unchanged, 2-> decrement
+        std::vector<float> data_0, data_1, cw, cw_ack, cw_query, delim, frame_sync, preamble, rtcal, trcal, query_rep,nak,p_down;
+        gen2_bits query_bits, ack_bits, query_adjust_bits, query_rep_bits;
+
+        // the constant commands are rendered once, the bits of Query (or
+        // QueryAdjust) and ACK into their own buffers, so an ACK can be queued
+        // while the Query is still being sent
+        std::vector<float> start_command, query_rep_command, query_command, ack_command;
+
+        // command being sent, as a list of cached waveforms drained across
+        // calls of general_work within noutput_items
+        struct waveform_segment
+        {
+          const float * samples;
+          int length;
+        };
+        std::vector<waveform_segment> segments;
+        int segment_index, segment_offset;
+
+        // the segment which starts the queued ACK, -1 once it is emitted,
+        // with the stamps its latencies are measured from
+        int ack_segment;
+        int64_t ack_open_time, ack_queued_time;
 
         void gen_query_bits();
-        void gen_ack_bits(const float * in);
+        void gen_ack_bits(uint16_t rn16);
         void gen_query_adjust_bits();
-        void crc_append(std::vector<float> & q);
+        void append_waveform(std::vector<float> &, const gen2_bits &);
+
+        // writes the live statistics while the flowgraph runs
+        stats_exporter exporter;
 
-        std::ofstream log;
-        int calc_usec(const struct timeval start, const struct timeval end);
+        logger log;
+        long calc_usec(const struct timeval start, const struct timeval end);
         void print_results();
+        void print_latency();
+        void print_latency_summary(std::ostream &);
+
+        void queue(const float *, int);
+        void queue(const std::vector<float> &);
+        void queue_command(const std::vector<float> &, const gen2_bits &, const std::vector<float> &, std::vector<float> &);
+        bool emitting() const { return segment_index < segments.size(); }
+        int emit(float * out, int noutput_items);
+        uint64_t wakes(void);
+        // sleeps until wake_reader() is called past n_wakes, at most READER_IDLE_WAIT_MS
+        void wait_idle(uint64_t n_wakes);
 
-        void transmit(float*, int*, std::vector<float>);
-        void transmit_bits(float*, int*, std::vector<float>);
+        // queues the ACK of an RN16 posted by the tag_decoder
+        void handle_rn16(pmt::pmt_t msg);
 
       public:
-        reader_impl(int sample_rate, int dac_rate);
+        reader_impl(reader_context::sptr context, int sample_rate, int dac_rate, const link_profile & profile);
         ~reader_impl();
-        void forecast(int, gr_vector_int&);
+        bool start();
+        bool stop();
+        void set_run_limits(double duration, int unique_tags, int queries);
         int general_work(int, gr_vector_int&, gr_vector_const_void_star&, gr_vector_void_star&);
     };
   }
@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_RN16_MESSAGE_H
+#define INCLUDED_RFID_RN16_MESSAGE_H
+
+#include <pmt/pmt.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // RN16 handoff from the tag_decoder to the reader
+    //
+    // The decoder posts every RN16 it decodes on its "rn16" message port and
+    // the reader queues the ACK from its message handler. The handoff is on
+    // the T2 critical path, so the message is the rn16_result struct itself
+    // as a u8vector, with no key lookups on either side:
+    //   rn16         the 16 bits packed MSB first
+    //   round, slot  inventory round and slot number of the reply
+    //   quality      preamble correlation of the channel it was decoded on
+    //   open_time, preamble_time, decode_time
+    //                latency_clock_ns() when the gate opened the window, when the
+    //                preamble was found and when the RN16 was decoded
+
+    struct rn16_result
+    {
+      uint16_t rn16;
+      int round;
+      int slot;
+      float quality;
+      int64_t open_time;
+      int64_t preamble_time;
+      int64_t decode_time;
+    };
+
+    inline const pmt::pmt_t & rn16_port(void)
+    {
+      static const pmt::pmt_t port = pmt::mp("rn16");
+      return port;
+    }
+
+    inline pmt::pmt_t rn16_result_to_pmt(const rn16_result & result)
+    {
+      return pmt::init_u8vector(sizeof(result), (const uint8_t *)&result);
+    }
+
+    // false if msg is not an rn16_result
+    inline bool rn16_result_from_pmt(const pmt::pmt_t & msg, rn16_result * result)
+    {
+      if(!pmt::is_u8vector(msg)) return false;
+
+      size_t len;
+      const uint8_t * data = pmt::u8vector_elements(msg, len);
+      if(len != sizeof(rn16_result)) return false;
+
+      memcpy(result, data, sizeof(rn16_result));
+      return true;
+    }
+  }
+}
+
+#endif
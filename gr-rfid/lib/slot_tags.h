@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_SLOT_TAGS_H
+#define INCLUDED_RFID_SLOT_TAGS_H
+
+#include <gnuradio/tags.h>
+#include <pmt/pmt.h>
+#include <stdint.h>
+#include "rfid/global_vars.h"
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Stream tags framing the open gate windows
+    //
+    // The gate tags the first sample of every window it emits with "rfid_sof"
+    // and the last one with "rfid_eof". Both carry the same dict, so the
+    // tag_decoder can frame slots from its own input stream:
+    //   round, slot  inventory round and slot number
+    //   mode         DECODER_DECODE_RN16 or DECODER_DECODE_EPC
+    //   index        absolute index of the first window sample in the gate input stream
+    //   length       number of samples in the window
+    //   gap          samples from the end of the reader command to the window start
+    //   open_time    latency_clock_ns() when the gate opened the window
+
+    struct slot_window
+    {
+      int round;
+      int slot;
+      DECODER_STATUS mode;
+      uint64_t index;
+      int length;
+      int gap;
+      int64_t open_time;
+    };
+
+    inline const pmt::pmt_t & slot_sof_key(void)
+    {
+      static const pmt::pmt_t key = pmt::intern("rfid_sof");
+      return key;
+    }
+
+    inline const pmt::pmt_t & slot_eof_key(void)
+    {
+      static const pmt::pmt_t key = pmt::intern("rfid_eof");
+      return key;
+    }
+
+    inline pmt::pmt_t slot_window_to_pmt(const slot_window & window)
+    {
+      pmt::pmt_t dict = pmt::make_dict();
+      dict = pmt::dict_add(dict, pmt::intern("round"), pmt::from_long(window.round));
+      dict = pmt::dict_add(dict, pmt::intern("slot"), pmt::from_long(window.slot));
+      dict = pmt::dict_add(dict, pmt::intern("mode"), pmt::from_long(window.mode));
+      dict = pmt::dict_add(dict, pmt::intern("index"), pmt::from_uint64(window.index));
+      dict = pmt::dict_add(dict, pmt::intern("length"), pmt::from_long(window.length));
+      dict = pmt::dict_add(dict, pmt::intern("gap"), pmt::from_long(window.gap));
+      dict = pmt::dict_add(dict, pmt::intern("open_time"), pmt::from_long(window.open_time));
+      return dict;
+    }
+
+    inline slot_window slot_window_from_pmt(const pmt::pmt_t & dict)
+    {
+      slot_window window;
+      window.round  = pmt::to_long(pmt::dict_ref(dict, pmt::intern("round"), pmt::from_long(0)));
+      window.slot   = pmt::to_long(pmt::dict_ref(dict, pmt::intern("slot"), pmt::from_long(0)));
+      window.mode   = (DECODER_STATUS)pmt::to_long(pmt::dict_ref(dict, pmt::intern("mode"), pmt::from_long(DECODER_DECODE_RN16)));
+      window.index  = pmt::to_uint64(pmt::dict_ref(dict, pmt::intern("index"), pmt::from_uint64(0)));
+      window.length = pmt::to_long(pmt::dict_ref(dict, pmt::intern("length"), pmt::from_long(0)));
+      window.gap    = pmt::to_long(pmt::dict_ref(dict, pmt::intern("gap"), pmt::from_long(0)));
+      window.open_time = pmt::to_long(pmt::dict_ref(dict, pmt::intern("open_time"), pmt::from_long(0)));
+      return window;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,156 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "stats_exporter.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace gr
+{
+  namespace rfid
+  {
+    static const char * SLOT_OUTCOME_NAMES[N_SLOT_OUTCOMES] = {"empty", "single", "collision", "unknown"};
+    static const char * SLOT_RESULT_NAMES[N_SLOT_RESULTS] = {"gate_fail", "preamble_fail", "rn16_ok", "crc_fail", "epc_ok"};
+
+    stats_exporter::stats_exporter(READER_STATE * reader_state, const std::string & path, const std::string & name, int period_ms)
+      : reader_state(reader_state), path(path), label(name.empty() ? "" : "reader=\"" + name + "\""), period_ms(period_ms), running(false)
+    {
+    }
+
+    stats_exporter::~stats_exporter()
+    {
+      stop();
+    }
+
+    void stats_exporter::start(void)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(running) return;
+
+      running = true;
+      thread = std::thread(&stats_exporter::run, this);
+    }
+
+    void stats_exporter::stop(void)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!running) return;
+        running = false;
+      }
+      wake.notify_all();
+      thread.join();
+    }
+
+    void stats_exporter::run(void)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+      while(running)
+      {
+        next += std::chrono::milliseconds(period_ms);
+        if(wake.wait_until(lock, next, [this] { return !running; })) break;
+
+        lock.unlock();
+        export_now();
+        lock.lock();
+      }
+    }
+
+    stats_exporter::snapshot stats_exporter::take(void) const
+    {
+      const READER_STATS & stats = reader_state->reader_stats;
+
+      snapshot s;
+      s.time     = latency_clock_ns();
+      s.queries  = stats.n_queries_sent.load();
+      s.acks     = stats.n_ack_sent.load();
+      s.repaired = stats.n_epc_repaired.load();
+      s.tags     = stats.n_tags.load();
+      for(int i=0 ; i<N_SLOT_OUTCOMES ; i++)
+        s.slots[i] = stats.n_slots[i].load();
+      for(int i=0 ; i<N_SLOT_RESULTS ; i++)
+        s.results[i] = stats.n_results[i].load();
+      s.round = stats.cur_inventory_round.load(std::memory_order_relaxed);
+      return s;
+    }
+
+    void stats_exporter::export_now(void)
+    {
+      std::lock_guard<std::mutex> lock(export_mutex);
+      snapshot now = take();
+
+      // the rates are taken over the window, so one slow period does not show as a drop
+      history.push_back(now);
+      if(history.size() > STATS_RATE_WINDOW + 1) history.pop_front();
+
+      write(now, history.front());
+    }
+
+    // "metric{labels} " with the label of the chain in front
+    std::string stats_exporter::series(const std::string & metric, const std::string & labels) const
+    {
+      std::string all = label.empty() ? labels : (labels.empty() ? label : label + "," + labels);
+      return all.empty() ? metric + " " : metric + "{" + all + "} ";
+    }
+
+    void stats_exporter::write(const snapshot & now, const snapshot & oldest)
+    {
+      double seconds = (now.time - oldest.time) / 1e9;
+      uint64_t reads = now.results[RESULT_EPC_OK] - oldest.results[RESULT_EPC_OK];
+      uint64_t slots = 0;
+      for(int i=0 ; i<N_SLOT_OUTCOMES ; i++)
+        slots += now.slots[i] - oldest.slots[i];
+
+      std::string tmp = path + ".tmp";
+      std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc);
+      if(!out) return;
+
+      out << "# TYPE rfid_queries_total counter" << std::endl;
+      out << series("rfid_queries_total") << now.queries << std::endl;
+      out << "# TYPE rfid_acks_total counter" << std::endl;
+      out << series("rfid_acks_total") << now.acks << std::endl;
+      out << "# TYPE rfid_slots_total counter" << std::endl;
+      for(int i=0 ; i<N_SLOT_OUTCOMES ; i++)
+        out << series("rfid_slots_total", std::string("outcome=\"") + SLOT_OUTCOME_NAMES[i] + "\"") << now.slots[i] << std::endl;
+      out << "# TYPE rfid_replies_total counter" << std::endl;
+      for(int i=0 ; i<N_SLOT_RESULTS ; i++)
+        out << series("rfid_replies_total", std::string("result=\"") + SLOT_RESULT_NAMES[i] + "\"") << now.results[i] << std::endl;
+      out << "# TYPE rfid_epc_repaired_total counter" << std::endl;
+      out << series("rfid_epc_repaired_total") << now.repaired << std::endl;
+      out << "# TYPE rfid_unique_tags gauge" << std::endl;
+      out << series("rfid_unique_tags") << now.tags << std::endl;
+      out << "# TYPE rfid_inventory_round gauge" << std::endl;
+      out << series("rfid_inventory_round") << now.round << std::endl;
+      out << "# TYPE rfid_reads_per_second gauge" << std::endl;
+      out << series("rfid_reads_per_second") << (seconds > 0 ? reads / seconds : 0) << std::endl;
+      out << "# TYPE rfid_slot_efficiency gauge" << std::endl;
+      out << series("rfid_slot_efficiency") << (slots ? (double)reads / slots : 0) << std::endl;
+      out.close();
+
+      std::rename(tmp.c_str(), path.c_str());
+    }
+  }
+}
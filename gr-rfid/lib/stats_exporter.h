@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_STATS_EXPORTER_H
+#define INCLUDED_RFID_STATS_EXPORTER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "rfid/global_vars.h"
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Periodic export of the reader statistics
+    //
+    // A thread of its own wakes up every period, reads the counters of
+    // READER_STATS and writes them in the Prometheus text format, with the
+    // reads/s and the slot efficiency over the last STATS_RATE_WINDOW
+    // periods. The file is written to a temporary and renamed, so a collector
+    // never reads half of it. The blocks only pay for their relaxed
+    // increments.
+
+    class stats_exporter
+    {
+      private:
+        struct snapshot
+        {
+          int64_t time;     // latency_clock_ns()
+          uint64_t queries, acks, repaired, tags;
+          uint64_t slots[N_SLOT_OUTCOMES];
+          uint64_t results[N_SLOT_RESULTS];
+          int round;
+        };
+
+        READER_STATE * reader_state;
+        std::string path;
+        std::string label;   // reader="name" of a named chain, so the files of several chains can be merged
+        int period_ms;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool running;
+
+        std::mutex export_mutex;       // export_now() runs on the thread and on the caller
+
+        std::deque<snapshot> history;  // snapshots of the rate window, oldest first
+
+        snapshot take(void) const;
+        std::string series(const std::string & metric, const std::string & labels = "") const;
+        void write(const snapshot & now, const snapshot & oldest);
+        void run(void);
+
+      public:
+        stats_exporter(READER_STATE * reader_state, const std::string & path, const std::string & name, int period_ms);
+        ~stats_exporter();
+
+        void start(void);
+        void stop(void);
+
+        // takes and writes one snapshot on the calling thread
+        void export_now(void);
+    };
+  }
+}
+
+#endif
@@ -4,49 +4,98 @@
 #endif
 
 #include "tag_decoder_impl.h"
+#include <volk/volk.h>
+#include <algorithm>
 #include <cmath>
 
+#define DC_SAMPLES 200  // the DC offset is the average of the first samples of the slot
+
 namespace gr
 {
   namespace rfid
   {
     tag_decoder_impl::sample_information::sample_information()
     {
-      _in = NULL;
+      _in_i = NULL;
+      _in_q = NULL;
+      _integral = NULL;
+      _sq_integral_i = NULL;
+      _sq_integral_q = NULL;
+      _has_integral = false;
+      _half_sum = NULL;
+      _corr_buf = NULL;
+      _corr_magn = NULL;
+      _capacity = 0;
       _total_size = 0;
       _corr = 0;
       _complex_corr = std::complex<float>(0.0,0.0);
       _avg_ampl = std::complex<float>(0.0,0.0);
+      _stddev_ampl = std::complex<float>(0.0,0.0);
+    }
+
+    tag_decoder_impl::sample_information::~sample_information()
+    {
+      volk_free(_in_i);
+      volk_free(_in_q);
+      volk_free(_integral);
+      volk_free(_sq_integral_i);
+      volk_free(_sq_integral_q);
+      volk_free(_half_sum);
+      volk_free(_corr_buf);
+      volk_free(_corr_magn);
     }
 
-    tag_decoder_impl::sample_information::sample_information(gr_complex* __in, int __total_size)
-    // mode: 0:RN16, 1:EPC
+    void tag_decoder_impl::sample_information::load(const gr_complex* __in, int __total_size)
     {
-      this->_in = __in;
-      this->_total_size = __total_size;
+      if(__total_size > _capacity)
+      {
+        volk_free(_in_i);
+        volk_free(_in_q);
+        volk_free(_integral);
+        volk_free(_sq_integral_i);
+        volk_free(_sq_integral_q);
+        volk_free(_half_sum);
+        volk_free(_corr_buf);
+        volk_free(_corr_magn);
+
+        size_t alignment = volk_get_alignment();
+        _capacity = __total_size;
+        _in_i = (float*)volk_malloc(_capacity * sizeof(float), alignment);
+        _in_q = (float*)volk_malloc(_capacity * sizeof(float), alignment);
+        _integral = (std::complex<double>*)volk_malloc((_capacity + 1) * sizeof(std::complex<double>), alignment);
+        _sq_integral_i = (double*)volk_malloc((_capacity + 1) * sizeof(double), alignment);
+        _sq_integral_q = (double*)volk_malloc((_capacity + 1) * sizeof(double), alignment);
+        _half_sum = (gr_complex*)volk_malloc(_capacity * sizeof(gr_complex), alignment);
+        _corr_buf = (gr_complex*)volk_malloc(_capacity * sizeof(gr_complex), alignment);
+        _corr_magn = (float*)volk_malloc(_capacity * sizeof(float), alignment);
+      }
+
+      _total_size = __total_size;
       _corr = 0;
       _complex_corr = std::complex<float>(0.0,0.0);
       _avg_ampl = std::complex<float>(0.0,0.0);
-      if(_total_size > 200){
-        //calculate ampl average
-        for(int i = 0; i < 200; i++){
-          _avg_ampl += _in[i];
-        }
-        _avg_ampl /= 200;
+      _stddev_ampl = std::complex<float>(0.0,0.0);
+      _has_integral = false;
+
+      volk_32fc_deinterleave_32f_x2(_in_i, _in_q, __in, _total_size);
 
-        //calculate ampl stddev
-        for(int i = 0; i < 200; i++){
-          gr_complex tmp_complex = _in[i] - _avg_ampl;
-          _stddev_ampl += std::complex<float>(std::pow(tmp_complex.real(),2), std::pow(tmp_complex.imag(),2));
+      if(_total_size > DC_SAMPLES){
+        //ampl average and stddev of the first samples
+        float avg_i, avg_q, stddev_i, stddev_q;
+        volk_32f_stddev_and_mean_32f_x2(&stddev_i, &avg_i, _in_i, DC_SAMPLES);
+        volk_32f_stddev_and_mean_32f_x2(&stddev_q, &avg_q, _in_q, DC_SAMPLES);
+        _avg_ampl = gr_complex(avg_i, avg_q);
+        _stddev_ampl = gr_complex(stddev_i, stddev_q);
+
+        //remove it once, the kernels read the arrays directly
+        for(int i = 0; i < _total_size; i++)
+        {
+          _in_i[i] -= avg_i;
+          _in_q[i] -= avg_q;
         }
-        _stddev_ampl /= 200;
-        _stddev_ampl = std::complex<float>(std::pow(_stddev_ampl.real(),0.5), std::pow(_stddev_ampl.imag(),0.5));
       }
-      
     }
 
-    tag_decoder_impl::sample_information::~sample_information(){}
-
     void tag_decoder_impl::sample_information::set_corr(float __corr)
     {
       _corr = __corr;
@@ -59,17 +108,57 @@ namespace gr
 
     gr_complex tag_decoder_impl::sample_information::in(int index)
     {
-      return _in[index]-_avg_ampl;
+      return gr_complex(_in_i[index], _in_q[index]);
     }
 
-    int tag_decoder_impl::sample_information::total_size(void)
+    void tag_decoder_impl::sample_information::build_integral(void)
     {
-      return _total_size;
+      _integral[0] = 0;
+      _sq_integral_i[0] = _sq_integral_q[0] = 0;
+      for(int i = 0; i < _total_size; i++)
+      {
+        _integral[i+1] = _integral[i] + std::complex<double>(_in_i[i], _in_q[i]);
+        _sq_integral_i[i+1] = _sq_integral_i[i] + _in_i[i] * _in_i[i];
+        _sq_integral_q[i+1] = _sq_integral_q[i] + _in_q[i] * _in_q[i];
+      }
+      _has_integral = true;
     }
 
-    float tag_decoder_impl::sample_information::norm_in(int index)
+    std::complex<double> tag_decoder_impl::sample_information::sum(int start, int length)
+    // sum of in() over [start, start+length), the part outside the buffer counts as zero
     {
-      return std::abs(_in[index]);
+      if(!_has_integral) build_integral();
+
+      int end = std::min(std::max(start + length, 0), _total_size);
+      start = std::min(std::max(start, 0), _total_size);
+      return _integral[end] - _integral[start];
+    }
+
+    std::complex<double> tag_decoder_impl::sample_information::sq_sum(int start, int length)
+    // sums of the squared I and Q over [start, start+length), as sum()
+    {
+      if(!_has_integral) build_integral();
+
+      int end = std::min(std::max(start + length, 0), _total_size);
+      start = std::min(std::max(start, 0), _total_size);
+      return std::complex<double>(_sq_integral_i[end] - _sq_integral_i[start], _sq_integral_q[end] - _sq_integral_q[start]);
+    }
+
+    double tag_decoder_impl::sample_information::variance(int start, int length)
+    // variance of in() over [start, start+length) of the buffer
+    {
+      start = std::min(std::max(start, 0), _total_size);
+      int end = std::min(std::max(start + length, start), _total_size);
+      if(end - start < 2) return 0;
+
+      std::complex<double> sq = sq_sum(start, end - start);
+      std::complex<double> mean = sum(start, end - start) / (double)(end - start);
+      return (sq.real() + sq.imag()) / (end - start) - std::norm(mean);
+    }
+
+    int tag_decoder_impl::sample_information::total_size(void)
+    {
+      return _total_size;
     }
 
     float tag_decoder_impl::sample_information::corr(void)
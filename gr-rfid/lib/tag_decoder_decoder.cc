@@ -4,6 +4,8 @@
 #endif
 
 #include "tag_decoder_impl.h"
+#include <volk/volk.h>
+#include <algorithm>
 #include <cmath>
 
 #define SHIFT_SIZE 5  // used in tag_detection
@@ -30,86 +32,81 @@ namespace gr
     {1, 1, -1, 1, -1, -1, 1, -1, -1, -1, 1, 1};
 
 
-    int tag_decoder_impl::tag_sync(sample_information* ys)
+    int tag_decoder_impl::tag_sync(sample_information* ys, int total_size)
       // This method searches the preamble and returns the start index of the tag data.
+      // Only the first total_size samples of ys are searched.
       // If the correlation value exceeds the threshold, it returns the start index of the tag data.
       // Else, it returns -1.
       // Threshold is an experimental value, so you might change this value within your environment.
     {
       int win_size = n_samples_TAG_BIT * TAG_PREAMBLE_BITS;
       float threshold = n_samples_TAG_BIT * 4;  // threshold verifing correlation value
-
-      gr_complex corr_temp(0.0f,0.0f);
-      gr_complex max_corr = 0.0f;
-      int max_index = 0;
-      gr_complex max_stddev = 0.0;
+      int half_bit = (int)n_samples_TAG_BIT/2;
 
       // compare all samples with sliding except T1
-      for(int i=0 ; i<ys->total_size()-win_size ; i++)  // i: start point
+      int n_offsets = total_size - win_size;
+      if(n_offsets <= 0) return -1;
+
+      // sum of every half bit, the preamble mask is constant over a half bit
+      int n_half = total_size - half_bit + 1;
+      gr_complex* half_sum = ys->half_sum_buffer();
+      for(int i=0 ; i<n_half ; i++)
+        half_sum[i] = gr_complex(ys->sum(i, half_bit));
+
+      // correlation of all offsets at once, one vector add/subtract per mask element
+      gr_complex* corr = ys->corr_buffer();
+      std::fill_n(corr, n_offsets, gr_complex(0,0));
+      float* corr_f = (float*)corr;
+      for(int k=0 ; k<TAG_PREAMBLE_MASKS_LENGTH ; k++)
       {
+        const float* half_f = (const float*)&half_sum[k * half_bit];
+        if(TAG_PREAMBLE_MASKS[k] > 0) volk_32f_x2_add_32f(corr_f, corr_f, half_f, 2 * n_offsets);
+        else volk_32f_x2_subtract_32f(corr_f, corr_f, half_f, 2 * n_offsets);
+      }
 
-        // calculate correlation value
-        if(i==0){
-          corr_temp = mask_correlation(ys, TAG_PREAMBLE_MASKS, TAG_PREAMBLE_MASKS_LENGTH, i , 1);
-        }else{
-          corr_temp = mask_shift_one_sample(ys,TAG_PREAMBLE_MASKS, TAG_PREAMBLE_MASKS_LENGTH, corr_temp, i, 1);
-        }
-
-        // get max correlation value for ith start point
-        std::complex<double> corr = corr_temp;
-
-        // compare with current max correlation value
-        if(std::abs(corr) > std::abs(max_corr))
-        {
-          // calculate average_amp (threshold)
-          std::complex<float> average_amp(0.0,0.0);
-          for(int j=0 ; j<win_size ; j++)
-            average_amp += ys->in(i+j);
-          average_amp /= win_size;
-
-          // calculate normalize_factor
-          std::complex<float> standard_deviation(0.0,0.0);
-          for(int j=0 ; j<win_size ; j++){
-            standard_deviation.real(standard_deviation.real() + pow(ys->in(i+j).real() - average_amp.real(), 2));
-            standard_deviation.imag(standard_deviation.imag() + pow(ys->in(i+j).imag() - average_amp.imag(), 2));
-
-          }
-
-          standard_deviation /= win_size;
-          standard_deviation.real(pow(standard_deviation.real(),0.5));
-          standard_deviation.imag(pow(standard_deviation.imag(),0.5));
-
-          max_corr = corr;
-          max_index = i;
-          max_stddev = standard_deviation;
-        }
+      // every offset is ranked by its correlation normalized by the standard deviation of its window,
+      // I and Q on their own, as a squared magnitude. The mean and variance of a window come from
+      // the prefix sums, so the score of an offset is O(1)
+      float* score = ys->corr_magn_buffer();
+      for(int k=0 ; k<n_offsets ; k++)
+      {
+        std::complex<double> mean = ys->sum(k, win_size) / (double)win_size;
+        std::complex<double> sq = ys->sq_sum(k, win_size) / (double)win_size;
+        double var_real = sq.real() - mean.real() * mean.real();
+        double var_imag = sq.imag() - mean.imag() * mean.imag();
+
+        if((var_real > 0) && (var_imag > 0))
+          score[k] = corr[k].real() * corr[k].real() / var_real + corr[k].imag() * corr[k].imag() / var_imag;
+        else
+          score[k] = 0;
       }
+      int max_index = std::max_element(score, score + n_offsets) - score;
+      float max_corr = std::sqrt(score[max_index]);
 
 
 #ifdef __DEBUG__
       debug_log << "threshold= " << threshold << std::endl;
-      debug_log << "corr= " << max_corr << std::endl;
+      debug_log << "corr= " << corr[max_index] << " normalized= " << max_corr << std::endl;
       debug_log << "preamble index= " << max_index << std::endl;
       debug_log << "sample index= " << max_index + win_size << std::endl;
 #endif
 
-      max_corr.real(max_corr.real()/max_stddev.real());
-      max_corr.imag(max_corr.imag()/max_stddev.imag());
-
       // check if correlation value exceeds threshold
-      if((std::abs(max_corr)) > threshold) return max_index + win_size;
+      if(max_corr > threshold) return max_index + win_size;
       else return -1;
     }
 
-    static int correct_bit = 0;
-
-    std::vector<float> tag_decoder_impl::tag_detection(sample_information* ys, int index, int n_expected_bit)
+    gen2_bits tag_decoder_impl::tag_detection(sample_information* ys, int index, int n_expected_bit, float* confidence, FM0_DECODER mode)
       // This method decodes n_expected_bit of data by using previous methods, and returns the vector of the decoded data.
       // index: start point of "data bit", do not decrease half bit!
+      // confidence: if not NULL, gets for every bit how much stronger the chosen mask correlates than the other one
+      // mode: FM0_GREEDY takes the best mask of every bit, FM0_VITERBI runs fm0_trellis over the same half bit sums
     {
-      std::vector<float> decoded_bits;
+      gen2_bits decoded_bits;
+      std::complex<double> bit_halves[GEN2_MAX_BITS][2];  // both halves of every bit at its best shift
 
 
+      int half_bit = (int)n_samples_TAG_BIT/2;
       int mask_level = 1;
       int shift = 0;
       double max_corr_sum = 0.0f;
@@ -123,34 +120,39 @@ namespace gr
         int curr_shift;
 
 
-        //culculate left most shifted correlation value
-        std::vector<std::complex<double>> corr_result(2), result(2);
+        //every mask correlation is built from the half bit sums of the prefix sum,
+        //so each shift costs FM0_MASKS_LENGTH lookups instead of a pass over the bit
+        std::complex<double> half[FM0_MASKS_LENGTH];
+        double max_norm = -1;
+        double bit_norm[2] = {0, 0};  // best correlation of each bit value over the shifts
 
-        //calculate new corr value by shifting left to right one sample each
         for(int j=-SHIFT_SIZE ; j<=SHIFT_SIZE ; j++)
         {
-          if(j == -SHIFT_SIZE){
-            corr_result[0] = mask_correlation(ys, FM0_MASKS[0], FM0_MASKS_LENGTH, idx+j, mask_level);
-            corr_result[1] = mask_correlation(ys, FM0_MASKS[1], FM0_MASKS_LENGTH, idx+j, mask_level);
-          }else{
-            corr_result[0] = mask_shift_one_sample(ys, FM0_MASKS[0], FM0_MASKS_LENGTH, corr_result[0], idx+j, mask_level);
-            corr_result[1] = mask_shift_one_sample(ys, FM0_MASKS[1], FM0_MASKS_LENGTH, corr_result[1], idx+j, mask_level);
-          }
+          for(int m=0 ; m<FM0_MASKS_LENGTH ; m++)
+            half[m] = ys->sum(idx + j + m*half_bit, half_bit);
 
           //Find the Biggest Correlation value
           for(int k=0; k<=1; k++){
-            if(std::abs(corr_result[k]) > std::abs(max_corr)){
-              max_corr = corr_result[k];
-              result[0] = corr_result[0];
-              result[1] = corr_result[1];
+            std::complex<double> corr(0,0);
+            for(int m=0 ; m<FM0_MASKS_LENGTH ; m++)
+              corr += half[m] * (double)FM0_MASKS[k][m];
+            corr *= mask_level;
+            bit_norm[k] = std::max(bit_norm[k], std::norm(corr));
+
+            if(std::norm(corr) > max_norm){
+              max_norm = std::norm(corr);
+              max_corr = corr;
               max_bit = k;
               curr_shift = j;
+              bit_halves[i][0] = half[1];
+              bit_halves[i][1] = half[2];
             }
           }
         }
 
         max_corr_sum += std::abs(max_corr);
         max_complex_corr_sum += max_corr;
+        if(confidence) confidence[i] = std::sqrt(bit_norm[max_bit]) - std::sqrt(bit_norm[1 - max_bit]);
 
 
 #ifdef __DEBUG__
@@ -167,76 +169,131 @@ namespace gr
           mask_level *= -1; // change mask_level(start level of the next bit) when the decoded bit is 1
         }
 
-        decoded_bits.push_back(max_bit);
+        decoded_bits.push(max_bit);
         shift += curr_shift;  // update the shift value
       }
 
       ys->set_corr(max_corr_sum/n_expected_bit);
       ys->set_complex_corr(max_complex_corr_sum/(float)n_expected_bit);
 
+      //the timing above does not depend on the bit decisions, so the trellis reuses it
+      if(mode == FM0_VITERBI)
+        return fm0_trellis(ys, index, bit_halves, n_expected_bit, confidence);
 
-      int data = 0;
-      for(int i = 0; i<16; i++){
-        data = data << 1;
-        data -= data & 1;
-        if(decoded_bits[i] > 0.5){
-          data += 1;
-        }        //std::cout<<in[i];
-      }
+      return decoded_bits;
+    }
 
-      if(data == 0xAAAA)
-        correct_bit++;
-      else{
-        data = (data ^ 0xAAAA);
-        int b_c = 0;
-        int data1 = data;
-        for(int i = 0; i<16; i++){
-          if(data1 % 2 == 1)
-            b_c++;
-          data1 /= 2;
-        }
-        std::cout << std::hex<<data<<std::dec<<", "<<b_c<<" | ";
+    gen2_bits tag_decoder_impl::fm0_trellis(sample_information* ys, int index, const std::complex<double> bit_halves[][2], int n_expected_bit, float* confidence)
+      // Viterbi search over the FM0 level trellis. The state is the level at the end of a bit:
+      // the level always inverts at a bit boundary, a 0 inverts it again at mid bit, a 1 does not.
+      // The half bit sums are projected on the phase of the preamble, which ends on a high level.
+      // confidence: if not NULL, gets for every bit how much better the best path is than the best
+      // path with the other value of the bit (max-log forward/backward over the same metrics)
+    {
+      int win_size = n_samples_TAG_BIT * TAG_PREAMBLE_BITS;
+      int half_bit = (int)n_samples_TAG_BIT/2;
 
-      }
+      std::complex<double> ref(0,0);
+      for(int k=0 ; k<TAG_PREAMBLE_MASKS_LENGTH ; k++)
+        ref += ys->sum(index - win_size + k*half_bit, half_bit) * (double)TAG_PREAMBLE_MASKS[k];
+      if(std::abs(ref) > 0) ref = std::conj(ref) / std::abs(ref);
+      else ref = 1;
 
-      std::cout<<correct_bit<<" | ";
+      //state 0: high level, state 1: low level
+      //branch[i][b][s]: metric of reaching s with bit b, a 0 comes from s with halves (-level, level),
+      //a 1 comes from the other state with halves (level, level)
+      double branch[GEN2_MAX_BITS][2][2];
+      double metric[GEN2_MAX_BITS+1][2];  // forward metric at the start of every bit
+      uint8_t from[GEN2_MAX_BITS][2];  // previous state of the survivor path
 
-      return decoded_bits;
-    }
+      metric[0][0] = 0;
+      metric[0][1] = -1e300;
 
+      for(int i=0 ; i<n_expected_bit ; i++)
+      {
+        double r1 = (bit_halves[i][0] * ref).real();
+        double r2 = (bit_halves[i][1] * ref).real();
 
-    std::complex<double> tag_decoder_impl::mask_correlation(sample_information * ys, const float mask_data[],const int mask_length, int index, int mask_level){
+        for(int s=0 ; s<2 ; s++)
+        {
+          double level = s ? -1 : 1;
+          branch[i][0][s] = -level*r1 + level*r2;
+          branch[i][1][s] = level*r1 + level*r2;
 
-      std::complex<double> result(0.0,0.0);
+          double m0 = metric[i][s] + branch[i][0][s];
+          double m1 = metric[i][1-s] + branch[i][1][s];
 
-      for(int i_mask = 0; i_mask < mask_length; i_mask++){
-        for(int i_sam = ((int)n_samples_TAG_BIT/2 * i_mask); i_sam < ((int)n_samples_TAG_BIT/2 * (i_mask + 1)); i_sam++){
-          result += (ys->in(index + i_sam) * mask_data[i_mask]);
+          if(m0 >= m1){
+            metric[i+1][s] = m0;
+            from[i][s] = s;
+          }else{
+            metric[i+1][s] = m1;
+            from[i][s] = 1-s;
+          }
         }
       }
 
-      result *= mask_level;
+      //the backward metrics give the best path through every branch
+      if(confidence)
+      {
+        double back[2] = {0, 0};
+        for(int i=n_expected_bit-1 ; i>=0 ; i--)
+        {
+          double best[2] = {-1e300, -1e300};  // best path with bit i = 0 and = 1
+          for(int s=0 ; s<2 ; s++)
+          {
+            best[0] = std::max(best[0], metric[i][s] + branch[i][0][s] + back[s]);
+            best[1] = std::max(best[1], metric[i][1-s] + branch[i][1][s] + back[s]);
+          }
+          confidence[i] = std::fabs(best[0] - best[1]);
+
+          double prev[2];
+          for(int p=0 ; p<2 ; p++)
+            prev[p] = std::max(branch[i][0][p] + back[p], branch[i][1][1-p] + back[1-p]);
+          back[0] = prev[0];
+          back[1] = prev[1];
+        }
+      }
 
-      return result;
-    }
+      //trace back from the best final state, a bit is 1 when the state changed
+      uint8_t decisions[GEN2_MAX_BITS];
+      int state = (metric[n_expected_bit][0] >= metric[n_expected_bit][1]) ? 0 : 1;
+      for(int i=n_expected_bit-1 ; i>=0 ; i--)
+      {
+        int prev = from[i][state];
+        decisions[i] = (prev != state);
+        state = prev;
+      }
 
-    std::complex<double> tag_decoder_impl::mask_shift_one_sample(sample_information * ys, const float mask_data[], const int mask_length, std::complex<double> prev_result, int index, int mask_level){
-      int prev_index = index - 1;
+      gen2_bits decoded_bits;
+      for(int i=0 ; i<n_expected_bit ; i++)
+        decoded_bits.push(decisions[i]);
 
-      std::complex<double> result(0.0,0.0);
+      return decoded_bits;
+    }
 
-      result -= (ys->in(prev_index) * mask_data[0]);
-      result += (ys->in(prev_index + ((int)n_samples_TAG_BIT/2 * (mask_length))) * mask_data[mask_length - 1]);
+    void tag_decoder_impl::log_bit_check(const gen2_bits & decoded_bits)
+      // Compares the first 16 decoded bits with the 0xAAAA test pattern and logs the result.
+      // It runs on the block thread, after the channels are decoded.
+    {
+      int data = decoded_bits.get(0, 16);
 
-      for(int i_mask = 1; i_mask < mask_length; i_mask++){
-        int i_sam = (int)n_samples_TAG_BIT/2 * i_mask;
-        result += (ys->in(prev_index + i_sam) * (mask_data[i_mask-1] - mask_data[i_mask]));
-      }
+      if(data == 0xAAAA)
+        n_bit_check_ok++;
+      else{
+        data = (data ^ 0xAAAA);
+        int b_c = 0;
+        int data1 = data;
+        for(int i = 0; i<16; i++){
+          if(data1 % 2 == 1)
+            b_c++;
+          data1 /= 2;
+        }
+        log.console("%x, %d | ", data, b_c);
 
-      result *= mask_level;
-      result += prev_result;
+      }
 
-      return result;           
+      log.console("%d | ", n_bit_check_ok);
     }
 
 
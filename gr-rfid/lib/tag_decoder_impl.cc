@@ -27,46 +27,73 @@
 #include <gnuradio/math.h>
 #include <cmath>
 #include <sys/time.h>
+#include <chrono>
+#include <algorithm>
+#include <thread>
 #include "tag_decoder_impl.h"
 
 #define PREAMBLE_SEARCH_BIT_SIZE  (8)
+#define REPLY_EARLIEST_T1         (0.75)  // a tag replies T1 after the command, minus its frequency tolerance
+#define MIN_NOISE_SAMPLES         (16)
 
 namespace gr
 {
   namespace rfid
   {
     tag_decoder::sptr
-      tag_decoder::make(int sample_rate)
+      tag_decoder::make(reader_context::sptr context, int sample_rate, int n_channels, const link_profile & profile)
       {
-        std::vector<int> output_sizes;
-        output_sizes.push_back(sizeof(float));
-        output_sizes.push_back(sizeof(gr_complex));
-
-        return gnuradio::get_initial_sptr(new tag_decoder_impl(sample_rate,output_sizes));
+        return gnuradio::get_initial_sptr(new tag_decoder_impl(context,sample_rate,n_channels,profile));
       }
 
 
 
 
-    tag_decoder_impl::tag_decoder_impl(int sample_rate, std::vector<int> output_sizes)
-      : gr::block("tag_decoder", gr::io_signature::make(1, 1, sizeof(gr_complex)), gr::io_signature::makev(2, 2, output_sizes)), s_rate(sample_rate)
+    tag_decoder_impl::tag_decoder_impl(reader_context::sptr context, int sample_rate, int n_channels, const link_profile & profile)
+      : gr::block("tag_decoder", gr::io_signature::make(n_channels, n_channels, sizeof(gr_complex)), gr::io_signature::make(1, 1, sizeof(gr_complex))),
+      context(context), reader_state(context->state()), s_rate(sample_rate), n_channels(n_channels),
+      pool(std::max(0, std::min(n_channels, (int)std::thread::hardware_concurrency()) - 1)), n_bit_check_ok(0),
+      log(context->file_path(log_file_path))
     {
-      char_bits = new char[128];
-      n_samples_TAG_BIT = TPRI_D * s_rate / pow(10,6);
-      n_samples_T1  = T1_D * (sample_rate / pow(10,6));
+      results.resize(n_channels);
+      for(int c=0 ; c<n_channels ; c++)
+        buffers.push_back(new sample_information());
+
+      // slots are framed by the gate's stream tags, they are not forwarded
+      set_tag_propagation_policy(TPP_DONT);
+      n_samples_TAG_BIT = profile.samples(profile.tpri, s_rate);
+      n_samples_T1  = profile.samples(profile.t1, sample_rate);
+
+      // the decoded RN16s go to the reader as messages, the output carries the windows
+      message_port_register_out(rn16_port());
+      set_min_output_buffer(2 * (EPC_BITS + TAG_PREAMBLE_BITS + EXTRA_BITS) * n_samples_TAG_BIT);
     }
 
 
 
 
-    tag_decoder_impl::~tag_decoder_impl(){}
+    tag_decoder_impl::~tag_decoder_impl()
+    {
+#ifdef DEBUG_TAG_DECODER_IMPL_FM0_BENCH
+      for(int c=0 ; c<n_channels ; c++)
+      {
+        if(results[c].bench_bits == 0) continue;
+        log.file("FM0 bench channel %d: greedy= %g ns/bit | viterbi= %g ns/bit | %d of %d bits differ\n", c,
+            results[c].bench_ns[0] / results[c].bench_bits, results[c].bench_ns[1] / results[c].bench_bits,
+            (int)results[c].bench_differ, (int)results[c].bench_bits);
+      }
+#endif
+      for(int c=0 ; c<n_channels ; c++)
+        delete buffers[c];
+    }
 
 
 
 
     void tag_decoder_impl::forecast(int noutput_items, gr_vector_int& ninput_items_required)
     {
-      ninput_items_required[0] = noutput_items;
+      for(int c=0 ; c<n_channels ; c++)
+        ninput_items_required[c] = noutput_items;
     }
 
 
@@ -75,222 +102,296 @@ namespace gr
 
     int tag_decoder_impl::general_work(int noutput_items, gr_vector_int& ninput_items, gr_vector_const_void_star& input_items, gr_vector_void_star& output_items)
     {
-      float* out = (float *)output_items[0];
+      gr_complex* out = (gr_complex *)output_items[0];
       int consumed = 0;
+      int written = 0;
+
+      //the gate opens all the channels together, so the windows are aligned on every input
+      int ninput = *std::min_element(ninput_items.begin(), ninput_items.end());
+
+      //the gate marks the first sample of every window with a SOF tag
+      std::vector<gr::tag_t> tags;
+      get_tags_in_range(tags, 0, nitems_read(0), nitems_read(0) + ninput, slot_sof_key());
+      std::sort(tags.begin(), tags.end(), gr::tag_t::offset_compare);
+
+      for(int i=0 ; i<tags.size() ; i++)
+      {
+        slot_window window = slot_window_from_pmt(tags[i].value);
+        int start = tags[i].offset - nitems_read(0);
+
+        // wait until the whole window is available
+        if(start + window.length > ninput) break;
+        if(written + window.length > noutput_items) break;
+
+        std::vector<const gr_complex*> in(n_channels);
+        for(int c=0 ; c<n_channels ; c++)
+          in[c] = (const gr_complex *)input_items[c] + start;
+
+        decode_window(in, window);
+
+        // the window of the first channel is forwarded
+        memcpy(out + written, in[0], sizeof(gr_complex) * window.length);
+        written += window.length;
+        consumed = start + window.length;
+      }
+
+      // samples outside of any window are dropped
+      if(tags.empty()) consumed = ninput;
+      else if(consumed == 0) consumed = tags[0].offset - nitems_read(0);
+
+      produce(0, written);
+      consume_each(consumed);
+      return WORK_CALLED_PRODUCE;
+    }
+
+    void tag_decoder_impl::detect_channel(const gr_complex* in, const slot_window & window, sample_information* ys, channel_result* result)
+    {
+      result->bits.clear();
+      result->reply_power = 0;
+      result->corr = 0;
+      result->complex_corr = 0;
+      result->crc_ok = false;
+
+      //the window is converted once, the sync and the detection share it
+      ys->load(in, window.length);
 
       //find preamble at here
-      if(!flag_preamble && (ninput_items[0] >= (n_samples_TAG_BIT * (TAG_PREAMBLE_BITS + PREAMBLE_SEARCH_BIT_SIZE))))
+      int search_size = std::min(window.length, (int)(n_samples_TAG_BIT * (TAG_PREAMBLE_BITS + PREAMBLE_SEARCH_BIT_SIZE)));
+      result->index = tag_sync(ys, search_size);
+      if(result->index == -1)
       {
-        sample_information ys ((gr_complex*)input_items[0], ninput_items[0]);
-        index = tag_sync(&ys);
-        flag_preamble = true;
+        //the window opens T1/2 after the command, the samples before the earliest reply are noise
+        int n_noise = (int)(n_samples_T1 * REPLY_EARLIEST_T1) - window.gap;
+        double noise = ys->variance(0, n_noise);
+        if((n_noise >= MIN_NOISE_SAMPLES) && (noise > 0))
+          result->reply_power = ys->variance(n_noise, window.length - n_noise) / noise;
+        else
+          result->reply_power = COLLISION_ENERGY_RATIO;
+        return;
       }
+      result->sync_time = latency_clock_ns();
+
+#ifdef DEBUG_TAG_DECODER_IMPL_FM0_BENCH
+      bench_fm0(ys, result, (window.mode == DECODER_DECODE_EPC) ? EPC_BITS-1 : RN16_BITS-1);
+#endif
 
-      // Processing only after n_samples_to_ungate are available and we need to decode
-      if(flag_preamble && (ninput_items[0] >= reader_state->n_samples_to_ungate) && (reader_state->gate_status == GATE_CLOSED))
+      if(window.mode == DECODER_DECODE_RN16)
+        result->bits = tag_detection(ys, result->index, RN16_BITS-1);  // RN16_BITS includes one dummy bit
+      else if(window.mode == DECODER_DECODE_EPC)
       {
-        flag_preamble = false;
+        result->bits = tag_detection(ys, result->index, EPC_BITS-1, result->confidence);  // EPC_BITS includes one dummy bit
+        result->crc_ok = gen2_check_crc16(result->bits, EPC_BITS-1);
+      }
+      result->corr = ys->corr();
+      result->complex_corr = ys->complex_corr();
+    }
 
-        int mode = -1;
-        if(reader_state->decoder_status == DECODER_DECODE_RN16) mode = 1;
-        else if(reader_state->decoder_status == DECODER_DECODE_EPC) mode = 2;
+    void tag_decoder_impl::decode_window(const std::vector<const gr_complex*> & in, const slot_window & window)
+    {
+      current_round_slot = std::to_string(window.round)+"_"+std::to_string(window.slot);
 
-        current_round_slot = (std::to_string(reader_state->reader_stats.cur_inventory_round)+"_"+std::to_string(reader_state->reader_stats.cur_slot_number)).c_str();
-        sample_information ys ((gr_complex*)input_items[0], ninput_items[0]);
+      //every channel is synchronized and decoded on its own
+      pool.run(n_channels, [&](int c) { detect_channel(in[c], window, buffers[c], &results[c]); });
+
+      //the RN16 comes from the channel with the strongest correlation,
+      //the EPC from a channel which passes the CRC check if there is one
+      int best = -1;
+      for(int c=0 ; c<n_channels ; c++)
+      {
+        if(results[c].index == -1) continue;
+        if((best == -1) || (results[c].crc_ok && !results[best].crc_ok)
+            || ((results[c].crc_ok == results[best].crc_ok) && (results[c].corr > results[best].corr)))
+          best = c;
+      }
 
 #ifdef __DEBUG_LOG__
+      debug_log.open((debug_folder_path+"log/"+current_round_slot).c_str(), std::ios::app);
+
+      debug_log << "cur_inventory_round= " << window.round << std::endl;
+      debug_log << "cur_slot_number= " << window.slot << std::endl << std::endl;
+      if(window.mode == DECODER_DECODE_RN16) debug_log << "##### DECODER_DECODE_RN16 #####" << std::endl;
+      else if(window.mode == DECODER_DECODE_EPC) debug_log << "##### DECODER_DECODE_EPC #####" << std::endl;
+      debug_log << "window index= " << window.index << std::endl;
+      debug_log << "window length= " << window.length << std::endl;
+      debug_log << "channel= " << best << std::endl;
+#endif
 
-        log.open(log_file_path, std::ios::app);
-        debug_log.open((debug_folder_path+"log/"+current_round_slot).c_str(), std::ios::app);
+      int mode = -1;
+      if(window.mode == DECODER_DECODE_RN16) mode = 1;
+      else if(window.mode == DECODER_DECODE_EPC) mode = 2;
 
-        debug_log << "cur_inventory_round= " << reader_state->reader_stats.cur_inventory_round << std::endl;
-        debug_log << "cur_slot_number= " << reader_state->reader_stats.cur_slot_number << std::endl << std::endl;
-        if(mode == 1) debug_log << "##### DECODER_DECODE_RN16 #####" << std::endl;
-        else if(mode == 2) debug_log << "##### DECODER_DECODE_EPC #####" << std::endl;
-        debug_log << "n_samples_to_ungate= " << reader_state->n_samples_to_ungate << std::endl;
-        debug_log << "ninput_items[0]= " << ninput_items[0] << std::endl;
-#endif
+      sample_information* ys = buffers[std::max(best, 0)];
 
 #ifdef DEBUG_TAG_DECODER_IMPL_INPUT
-        debug_input(&ys, mode, current_round_slot);
+      debug_input(ys, mode, current_round_slot);
 #endif
 
-        if(index == -1)
-        {
+      if(best == -1)
+      {
 #ifdef __DEBUG_LOG__
-          log << "│ Preamble detection fail.." << std::endl;
-          debug_log << "Preamble detection fail" << std::endl << std::endl;
+        log.file("│ Preamble detection fail..\n");
+        debug_log << "Preamble detection fail" << std::endl << std::endl;
 #endif
-          std::cout << "\t\t\t\t\tPreamble FAIL!!";
-          goto_next_slot();
-        }
-        else
+        log.console("\t\t\t\t\tPreamble FAIL!!");
+        reader_state->reader_stats.n_results[RESULT_PREAMBLE_FAIL].add();
+
+        //the gate opens after every decoded command, a window with only noise is an empty slot,
+        //one with a reply but no preamble is a collision. After an ACK the RN16 was single.
+        SLOT_OUTCOME outcome = SLOT_SINGLE;
+        if(mode == 1)
         {
+          float reply_power = 0;
+          for(int c=0 ; c<n_channels ; c++)
+            reply_power = std::max(reply_power, results[c].reply_power);
+          outcome = (reply_power >= COLLISION_ENERGY_RATIO) ? SLOT_COLLISION : SLOT_EMPTY;
+        }
+        goto_next_slot(outcome);
+      }
+      else
+      {
 #ifdef __DEBUG_LOG__
-          log << "│ Preamble detected!" << std::endl;
+        log.file("│ Preamble detected!\n");
 #endif
 
+        //T1 is counted on the sample clock up to the start of the preamble
+        READER_STATS & stats = reader_state->reader_stats;
+        int preamble_start = results[best].index - (int)(n_samples_TAG_BIT * TAG_PREAMBLE_BITS);
+        stats.latency[LAT_TAG_T1].record((int64_t)((window.gap + preamble_start) * 1e9 / s_rate));
+        stats.latency[LAT_GATE_TO_PREAMBLE].record(results[best].sync_time - window.open_time);
+
 #ifdef DEBUG_TAG_DECODER_IMPL_PREAMBLE
-          debug_preamble(&ys, mode, current_round_slot, index);
+        debug_preamble(ys, mode, current_round_slot, results[best].index);
 #endif
 
 #ifdef DEBUG_TAG_DECODER_IMPL_SAMPLE
-          debug_sample(&ys, mode, current_round_slot, index);
+        debug_sample(ys, mode, current_round_slot, results[best].index);
 #endif
 
-          if(mode == 1) decode_RN16(&ys, index, out);
-          else if(mode == 2) decode_EPC(&ys, index);
-        }
+        //no channel passed the CRC, the weak bits of the best one are retried
+        bool repaired = false;
+        if((mode == 2) && !results[best].crc_ok)
+        {
+          const float* confidence = results[best].confidence;
+          float mean_confidence = std::accumulate(confidence, confidence + EPC_BITS-1, 0.0f) / (EPC_BITS-1);
 
+          int n_flipped = gen2_repair_crc16(&results[best].bits, EPC_BITS-1, confidence, CRC_REPAIR_BITS, CRC_REPAIR_CONFIDENCE * mean_confidence);
+          if(n_flipped > 0)
+          {
+            repaired = true;
+            reader_state->reader_stats.n_epc_repaired.add();
 #ifdef __DEBUG_LOG__
-        log.close();
-        debug_log.close();
+            log.file("│ CRC repaired, %d bits flipped\n", n_flipped);
 #endif
+          }
+        }
 
-        // process for GNU RADIO
-        produce(1, ninput_items[0]);
-        consumed = reader_state->n_samples_to_ungate;
+        if(mode == 1) decode_RN16(results[best].bits, window, results[best].corr, results[best].sync_time);
+        else if(mode == 2) decode_EPC(results[best].bits, window, results[best].complex_corr, repaired);
       }
 
-      consume_each(consumed);
-      return WORK_CALLED_PRODUCE;
+#ifdef __DEBUG_LOG__
+      debug_log.close();
+#endif
     }
 
 
 
-    void tag_decoder_impl::decode_RN16(sample_information* ys, int index, float* out)
+    void tag_decoder_impl::decode_RN16(const gen2_bits & RN16_bits, const slot_window & window, float corr, int64_t sync_time)
     {
-      std::vector<float> RN16_bits = tag_detection(ys, index, RN16_BITS-1);  // RN16_BITS includes one dummy bit
+      log_bit_check(RN16_bits);
 
 #ifdef __DEBUG_LOG__
-      // write RN16_bits to the next block
-      log << "│ RN16=";
       debug_log << "RN16= ";
-#endif
-      int written = 0;
+      log_bits rn16_log = {RN16_bits.get(0, RN16_bits.size()), RN16_bits.size()};
       for(int i=0 ; i<RN16_bits.size() ; i++)
       {
-        out[written++] = RN16_bits[i];
-#ifdef __DEBUG_LOG__
         if(i % 4 == 0)
-        {
-          log << " ";
           debug_log << " ";
-        }
-        log << RN16_bits[i];
         debug_log << RN16_bits[i];
-
-#endif
-
       }
-#ifdef __DEBUG_LOG__
       debug_log << std::endl << std::endl;
+      log.file("│ RN16=%b\n", rn16_log);
 #endif
 
-      produce(0, written);
-
       // go to the next state
 #ifdef __DEBUG_LOG__
-      log << std::endl << "├──────────────────────────────────────────────────" << std::endl;
+      log.file("├──────────────────────────────────────────────────\n");
 #endif
 
-      std::cout << "RN16 decoded | ";
-      reader_state->gen2_logic_status = SEND_ACK;
+      log.console("RN16 decoded | ");
+      reader_state->reader_stats.n_results[RESULT_RN16_OK].add();
+
+      // the reader queues the ACK as soon as it gets the message
+      int64_t decode_time = latency_clock_ns();
+      reader_state->reader_stats.latency[LAT_PREAMBLE_TO_RN16].record(decode_time - sync_time);
+
+      rn16_result result = {(uint16_t)RN16_bits.get(0, 16), window.round, window.slot, corr, window.open_time, sync_time, decode_time};
+      message_port_pub(rn16_port(), rn16_result_to_pmt(result));
+      wake_reader(reader_state);
     }
 
 
 
-    void tag_decoder_impl::decode_EPC(sample_information* ys, int index)
+    void tag_decoder_impl::decode_EPC(const gen2_bits & EPC_bits, const slot_window & window, gr_complex corr, bool repaired)
     {
-      std::vector<float> EPC_bits = tag_detection(ys, index, EPC_BITS-1);  // EPC_BITS includes one dummy bit
-
-      // convert EPC_bits from float to char in order to use Buettner's function
+      log_bit_check(EPC_bits);
 
 #ifdef __DEBUG_LOG__
-
-      log << "│ EPC=";
       debug_log << "EPC=";
-
-#endif
-
-      for(unsigned int i=0 ; i<EPC_bits.size() ; i++)
+      for(int i=0 ; i<EPC_bits.size() ; i++)
       {
-        char_bits[i] = EPC_bits[i] + '0';
-#ifdef __DEBUG_LOG__
         if(i % 4 == 0)
-        {
-          log << " ";
           debug_log << " ";
-        }
-        log << EPC_bits[i];
         debug_log << EPC_bits[i];
         if(i % 16 == 15)
         {
-          log << std::endl << "│     ";
+          log_bits epc_log = {EPC_bits.get(i - 15, 16), 16};
+          if(i == 15) log.file("│ EPC=%b\n", epc_log);
+          else log.file("│     %b\n", epc_log);
           debug_log << std::endl << "    ";
         }
-#endif
       }
+#endif
 
       // check CRC
-      if(check_crc(char_bits, 128) == 1) // success to decode EPC
+      if(gen2_check_crc16(EPC_bits, EPC_BITS-1)) // success to decode EPC
       {
-        // calculate tag_id
-        int tag_id = 0;
-        for(int i=0 ; i<8 ; i++)
-          tag_id += std::pow(2, 7-i) * EPC_bits[104+i];
+        // short tag id for the log (EPC[104:111]), the table keeps the whole EPC
+        int tag_id = EPC_bits.get(104, 8);
 
 #ifdef __DEBUG_LOG__
-        log << " CRC check success! Tag ID= " << tag_id << std::endl;
+        log.file("│ CRC check success! Tag ID= %d\n", tag_id);
         debug_log << " Tag ID= " << tag_id << std::endl << std::endl;
 #endif
-        std::cout << "\t\t\t\t\t\t\t\t\t\tTag ID= " << tag_id;
-        reader_state->reader_stats.n_epc_correct+=1;
+        log.console("\t\t\t\t\t\t\t\t\t\tTag ID= %d", tag_id);
+        reader_state->reader_stats.n_results[RESULT_EPC_OK].add();
 
-        // Save part of Tag's EPC message (EPC[104:111] in decimal) + number of reads
-        std::map<int,int>::iterator it = reader_state->reader_stats.tag_reads.find(tag_id);
-        if ( it != reader_state->reader_stats.tag_reads.end())
-          it->second ++;
-        else
-          reader_state->reader_stats.tag_reads[tag_id]=1;
+        // Save the whole PC + EPC with its statistics, a repaired read only counts once the tag is read clean
+        reader_state->reader_stats.tag_reads.set_max_tags(reader_state->run_limits.max_table_tags);
+        reader_state->reader_stats.tag_reads.add_read(EPC_bits, window.index, corr, repaired);
+        reader_state->reader_stats.n_tags.store(reader_state->reader_stats.tag_reads.confirmed());
       }
       else
       {
 #ifdef __DEBUG_LOG__
-        log << " CRC check fail.." << std::endl;
+        log.file("│ CRC check fail..\n");
         debug_log << "CRC check fail" << std::endl << std::endl;
 #endif
-        std::cout << "\t\t\t\t\tCRC FAIL!!";
+        log.console("\t\t\t\t\tCRC FAIL!!");
+        reader_state->reader_stats.n_results[RESULT_CRC_FAIL].add();
       }
 
-      goto_next_slot();
+      goto_next_slot(SLOT_SINGLE);
     }
 
-    void tag_decoder_impl::goto_next_slot(void)
+    void tag_decoder_impl::goto_next_slot(SLOT_OUTCOME outcome)
     {
-      reader_state->reader_stats.cur_slot_number++;
-      if(reader_state->reader_stats.cur_slot_number > reader_state->reader_stats.max_slot_number)
-      {
-        reader_state->reader_stats.cur_inventory_round ++;
-        reader_state->reader_stats.cur_slot_number = 1;
-
-#ifdef  __DEBUG_LOG__
-        log << "└──────────────────────────────────────────────────" << std::endl;
-#endif
-        if(reader_state->reader_stats.cur_inventory_round > MAX_NUM_QUERIES)
-        {
-          reader_state->reader_stats.cur_inventory_round--;
-          reader_state->decoder_status = DECODER_TERMINATED;
-        }
-        else reader_state->gen2_logic_status = SEND_QUERY;
-      }
-      else
-      {
 #ifdef __DEBUG_LOG__
-        log << "├──────────────────────────────────────────────────" << std::endl;
+      if(end_slot(reader_state, outcome)) log.file("└──────────────────────────────────────────────────\n");
+      else log.file("├──────────────────────────────────────────────────\n");
+#else
+      end_slot(reader_state, outcome);
 #endif
-        reader_state->gen2_logic_status = SEND_QUERY_REP;
-      }
     }
 
 #ifdef DEBUG_TAG_DECODER_
@@ -366,51 +467,23 @@ namespace gr
     }
 #endif
 
-    /* Function adapted from https://www.cgran.org/wiki/Gen2 */
-    int tag_decoder_impl::check_crc(char * bits, int num_bits)
+#ifdef DEBUG_TAG_DECODER_IMPL_FM0_BENCH
+    void tag_decoder_impl::bench_fm0(sample_information* ys, channel_result* result, int n_bits)
     {
-      register unsigned short i, j;
-      register unsigned short crc_16, rcvd_crc;
-      unsigned char * data;
-      int num_bytes = num_bits / 8;
-      data = (unsigned char* )malloc(num_bytes );
-      int mask;
-
-      for(i = 0; i < num_bytes; i++)
-      {
-        mask = 0x80;
-        data[i] = 0;
-        for(j = 0; j < 8; j++)
-        {
-          if (bits[(i * 8) + j] == '1'){
-            data[i] = data[i] | mask;
-          }
-          mask = mask >> 1;
-        }
-      }
-      rcvd_crc = (data[num_bytes - 2] << 8) + data[num_bytes -1];
+      gen2_bits bits[2];
+      FM0_DECODER modes[2] = {FM0_GREEDY, FM0_VITERBI};
 
-      crc_16 = 0xFFFF;
-      for (i=0; i < num_bytes - 2; i++)
+      for(int m=0 ; m<2 ; m++)
       {
-        crc_16^=data[i] << 8;
-        for (j=0;j<8;j++)
-        {
-          if (crc_16&0x8000)
-          {
-            crc_16 <<= 1;
-            crc_16 ^= 0x1021;
-          }
-          else
-            crc_16 <<= 1;
-        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bits[m] = tag_detection(ys, result->index, n_bits, NULL, modes[m]);
+        result->bench_ns[m] += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
       }
-      crc_16 = ~crc_16;
 
-      if(rcvd_crc != crc_16)
-        return -1;
-      else
-        return 1;
+      for(int i=0 ; i<n_bits ; i++)
+        result->bench_differ += (bits[0][i] != bits[1][i]);
+      result->bench_bits += n_bits;
     }
+#endif
   }
 }
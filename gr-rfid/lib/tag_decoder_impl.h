@@ -24,6 +24,10 @@
 #include <rfid/tag_decoder.h>
 #include <vector>
 #include "rfid/global_vars.h"
+#include "logger.h"
+#include "slot_tags.h"
+#include "rn16_message.h"
+#include "worker_pool.h"
 #include <time.h>
 #include <numeric>
 #include <fstream>
@@ -31,6 +35,7 @@
 //#define DEBUG_TAG_DECODER_IMPL_INPUT
 //#define DEBUG_TAG_DECODER_IMPL_PREAMBLE
 //#define DEBUG_TAG_DECODER_IMPL_SAMPLE
+//#define DEBUG_TAG_DECODER_IMPL_FM0_BENCH  // times FM0_GREEDY against FM0_VITERBI on every window
 //define __DEBUG_LOG__
 
 namespace gr
@@ -40,35 +45,60 @@ namespace gr
     class tag_decoder_impl : public tag_decoder
     {
       private:
+        reader_context::sptr context;
+        READER_STATE * reader_state;  // state of the chain, owned by the context
+
         float n_samples_TAG_BIT;
         int n_samples_T1;
         int s_rate;
-        char * char_bits;
-        int index;
-
-        bool flag_preamble = false;
+        int n_channels;
 
+        // DC removed samples of one slot, I and Q in separate aligned arrays.
+        // One buffer per channel is reused for every slot, it only grows.
         class sample_information
         {
           private:
-            gr_complex* _in;
+            float* _in_i;
+            float* _in_q;
+            int _capacity;
             int _total_size;
             float _corr;
             gr_complex _complex_corr;
             gr_complex _avg_ampl;
             gr_complex _stddev_ampl;
 
+            // prefix sums of in() and of its squared I and Q, built on the first call which needs them
+            std::complex<double>* _integral;
+            double* _sq_integral_i;
+            double* _sq_integral_q;
+            bool _has_integral;
+            void build_integral(void);
+
+            // scratch of tag_sync, one element per sample
+            gr_complex* _half_sum;
+            gr_complex* _corr_buf;
+            float* _corr_magn;
+
           public:
             sample_information();
-            sample_information(gr_complex*, int);
             ~sample_information();
 
+            void load(const gr_complex*, int);
+
             void set_corr(float);
             void set_complex_corr(gr_complex);
 
+            const float* in_i(void) const { return _in_i; }
+            const float* in_q(void) const { return _in_q; }
             gr_complex in(int);
+            std::complex<double> sum(int, int);
+            std::complex<double> sq_sum(int, int);  // sums of the squared I (real) and Q (imag)
+            double variance(int, int);
+
+            gr_complex* half_sum_buffer(void) { return _half_sum; }
+            gr_complex* corr_buffer(void) { return _corr_buf; }
+            float* corr_magn_buffer(void) { return _corr_magn; }
             int total_size(void);
-            float norm_in(int);
 
             float corr(void);
             gr_complex complex_corr(void);
@@ -76,24 +106,49 @@ namespace gr
             gr_complex stddev_ampl(void);
         };
 
+        // result of the sync and detection on one channel
+        struct channel_result
+        {
+          int index;                // start of the tag data, -1 if no preamble was found
+          float reply_power;        // without a preamble, power of the reply part over the noise before it
+          gen2_bits bits;
+          float confidence[GEN2_MAX_BITS];  // soft confidence of every bit, see tag_detection
+          float corr;
+          gr_complex complex_corr;
+          bool crc_ok;
+          int64_t sync_time;        // latency_clock_ns() when the preamble was found
+#ifdef DEBUG_TAG_DECODER_IMPL_FM0_BENCH
+          double bench_ns[2];   // detection time of FM0_GREEDY and FM0_VITERBI
+          long bench_bits;
+          long bench_differ;    // bits the two modes decided differently
+#endif
+        };
+        std::vector<channel_result> results;
+        std::vector<sample_information*> buffers;
+
+        // the per-channel sync and detection runs on this pool, one task per channel
+        worker_pool pool;
+
         // tag_decoder_impl.cc
-        void decode_RN16(sample_information*, int, float*);
-        void decode_EPC(sample_information*, int);
-        void goto_next_slot(void);
-        int check_crc(char*, int);
+        void decode_window(const std::vector<const gr_complex*>&, const slot_window&);
+        void detect_channel(const gr_complex*, const slot_window&, sample_information*, channel_result*);
+        void decode_RN16(const gen2_bits&, const slot_window&, float, int64_t);
+        void decode_EPC(const gen2_bits&, const slot_window&, gr_complex, bool);
+        void goto_next_slot(SLOT_OUTCOME outcome);
 
         // tag_decoder_decoder.cc
-        int tag_sync(sample_information*);
-        std::vector<float> tag_detection(sample_information*, int, int);
+        int tag_sync(sample_information*, int);
+        gen2_bits tag_detection(sample_information*, int, int, float* confidence = NULL, FM0_DECODER mode = FM0_DECODER_MODE);
+        gen2_bits fm0_trellis(sample_information*, int, const std::complex<double>[][2], int, float* confidence = NULL);
+        void log_bit_check(const gen2_bits&);
+        int n_bit_check_ok;  // replies which matched the test pattern in log_bit_check
         int determine_first_mask_level(sample_information*, int);
-        std::complex<double> mask_correlation(sample_information *, const float[], const int, int index = 0,int mask_level = 1);
-        std::complex<double> mask_shift_one_sample(sample_information *, const float[], const int, std::complex<double>, int prev_index = 0, int mask_level = 1);
 
 
         // debug_message
         std::string current_round_slot;
+        logger log;
 #ifdef __DEBUG_LOG__
-        std::ofstream log;
         std::ofstream debug_log;
 #endif
 #ifdef DEBUG_TAG_DECODER_IMPL_INPUT
@@ -105,9 +160,12 @@ namespace gr
 #ifdef DEBUG_TAG_DECODER_IMPL_SAMPLE
         void debug_sample(sample_information*, int, std::string, int);
 #endif
+#ifdef DEBUG_TAG_DECODER_IMPL_FM0_BENCH
+        void bench_fm0(sample_information*, channel_result*, int);
+#endif
 
       public:
-        tag_decoder_impl(int, std::vector<int>);
+        tag_decoder_impl(reader_context::sptr, int, int, const link_profile &);
         ~tag_decoder_impl();
         void forecast(int, gr_vector_int&);
         int general_work(int, gr_vector_int&, gr_vector_const_void_star&, gr_vector_void_star&);
@@ -0,0 +1,106 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "worker_pool.h"
+
+namespace gr
+{
+  namespace rfid
+  {
+    worker_pool::worker_pool(int n_threads)
+      : task(NULL), n_tasks(0), next_task(0), n_busy(0), batch(0), stop(false)
+    {
+      for(int i = 0; i < n_threads; i++)
+        threads.push_back(std::thread(&worker_pool::work, this));
+    }
+
+    worker_pool::~worker_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      start_cv.notify_all();
+
+      for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    }
+
+    void worker_pool::run(int n_tasks, const std::function<void(int)> & task)
+    {
+      if(threads.empty() || n_tasks <= 1)
+      {
+        for(int i = 0; i < n_tasks; i++) task(i);
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->n_tasks = n_tasks;
+        next_task = 0;
+        n_busy = threads.size();
+        batch++;
+      }
+      start_cv.notify_all();
+
+      // the calling thread takes tasks as well
+      run_tasks();
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done_cv.wait(lock, [this]{ return n_busy == 0; });
+      this->task = NULL;
+    }
+
+    void worker_pool::run_tasks(void)
+    {
+      int i;
+      while((i = next_task.fetch_add(1)) < n_tasks)
+        (*task)(i);
+    }
+
+    void worker_pool::work(void)
+    {
+      unsigned int seen = 0;
+
+      while(true)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          start_cv.wait(lock, [this, seen]{ return stop || (batch != seen); });
+          if(stop) return;
+          seen = batch;
+        }
+
+        run_tasks();
+
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          n_busy--;
+        }
+        done_cv.notify_one();
+      }
+    }
+  }
+}
@@ -0,0 +1,71 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2015 <Nikos Kargas (nkargas@isc.tuc.gr)>.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_RFID_WORKER_POOL_H
+#define INCLUDED_RFID_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gr
+{
+  namespace rfid
+  {
+    // Fixed pool of worker threads for the per-channel DSP
+    //
+    // run() hands out the tasks 0..n_tasks-1 to the workers and to the
+    // calling thread, and returns when all of them are done. A pool of zero
+    // threads runs every task inline on the calling thread.
+
+    class worker_pool
+    {
+      private:
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+
+        const std::function<void(int)> * task;
+        int n_tasks;
+        std::atomic<int> next_task;
+        int n_busy;             // workers still running the current batch
+        unsigned int batch;     // incremented for every run()
+        bool stop;
+
+        void work(void);
+        void run_tasks(void);
+
+      public:
+        worker_pool(int n_threads);
+        ~worker_pool();
+
+        int size(void) const { return threads.size(); }
+
+        void run(int n_tasks, const std::function<void(int)> & task);
+    };
+  }
+}
+
+#endif
@@ -8,11 +8,21 @@
 %include "rfid_swig_doc.i"
 
 %{
+#include "rfid/link_profile.h"
+#include "rfid/reader_context.h"
 #include "rfid/reader.h"
 #include "rfid/gate.h"
 #include "rfid/tag_decoder.h"
 %}
 
+%include "rfid/link_profile.h"
+
+%include "rfid/reader_context.h"
+%template(reader_context_sptr) boost::shared_ptr<gr::rfid::reader_context>;
+%pythoncode %{
+reader_context = reader_context.make;
+%}
+
 %include "rfid/reader.h"
 GR_SWIG_BLOCK_MAGIC2(rfid, reader);
 